@@ -0,0 +1,184 @@
+//===- BenchCompare.cpp - Compare results of the Toy compilation benchmark ===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a tool comparing two JSON results of
+// `toy-compile-bench-ch3`, a baseline and a candidate. The wall time, CPU
+// time and peak resident set size of every phase of every file are printed
+// side by side, and the ones growing by more than a threshold are flagged as
+// regressions. Small absolute changes are ignored as noise whatever their
+// ratio, as the fastest phases only take a few microseconds.
+//
+// The tool exits with 1 when it finds a regression and 2 on invalid inputs, so
+// that it can gate changes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace cl = llvm::cl;
+
+static cl::opt<std::string> baselineFilename(cl::Positional, cl::Required,
+                                             cl::desc("<baseline json>"));
+
+static cl::opt<std::string> candidateFilename(cl::Positional, cl::Required,
+                                              cl::desc("<candidate json>"));
+
+static cl::opt<double> threshold(
+    "threshold",
+    cl::desc("Growth in percent above which a measurement regresses"),
+    cl::init(5.0));
+
+static cl::opt<double> minTimeDelta(
+    "min-time-delta",
+    cl::desc("Smallest change of a time in ms that can regress"),
+    cl::init(0.5));
+
+static cl::opt<double> minRSSDelta(
+    "min-rss-delta",
+    cl::desc("Smallest change of a peak resident set size in KB that can "
+             "regress"),
+    cl::init(1024));
+
+namespace {
+/// The measurements of a phase of the compilation of a file.
+struct Measurement {
+  double wallTime = 0, cpuTime = 0, peakRSS = 0;
+};
+
+/// The measurements of a result file, keyed by "<file>:<phase>" in the order
+/// they appear.
+struct Results {
+  std::vector<std::string> keys;
+  llvm::StringMap<Measurement> measurements;
+};
+} // namespace
+
+static llvm::Error makeError(llvm::StringRef filename,
+                             const llvm::Twine &message) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 filename + ": " + message);
+}
+
+static llvm::Expected<Results> readResults(llvm::StringRef filename) {
+  auto fileOrErr = llvm::MemoryBuffer::getFileOrSTDIN(filename);
+  if (std::error_code ec = fileOrErr.getError())
+    return makeError(filename, ec.message());
+  llvm::Expected<llvm::json::Value> json =
+      llvm::json::parse((*fileOrErr)->getBuffer());
+  if (!json)
+    return makeError(filename, llvm::toString(json.takeError()));
+
+  Results results;
+  const llvm::json::Object *root = json->getAsObject();
+  const llvm::json::Array *files = root ? root->getArray("files") : nullptr;
+  if (!files)
+    return makeError(filename, "expected an object with a \"files\" array");
+  for (const llvm::json::Value &fileValue : *files) {
+    const llvm::json::Object *file = fileValue.getAsObject();
+    std::optional<llvm::StringRef> name =
+        file ? file->getString("file") : std::nullopt;
+    const llvm::json::Array *phases = file ? file->getArray("phases") : nullptr;
+    if (!name || !phases)
+      return makeError(filename, "expected a \"file\" and a \"phases\" array "
+                                 "for every file");
+    for (const llvm::json::Value &phaseValue : *phases) {
+      const llvm::json::Object *phase = phaseValue.getAsObject();
+      std::optional<llvm::StringRef> phaseName =
+          phase ? phase->getString("name") : std::nullopt;
+      std::optional<double> wallTime =
+          phase ? phase->getNumber("wall_ms") : std::nullopt;
+      std::optional<double> cpuTime =
+          phase ? phase->getNumber("cpu_ms") : std::nullopt;
+      std::optional<double> peakRSS =
+          phase ? phase->getNumber("peak_rss_kb") : std::nullopt;
+      if (!phaseName || !wallTime || !cpuTime || !peakRSS)
+        return makeError(filename, "incomplete phase of " + *name);
+      std::string key = (*name + ":" + *phaseName).str();
+      Measurement measurement{*wallTime, *cpuTime, *peakRSS};
+      if (!results.measurements.try_emplace(key, measurement).second)
+        return makeError(filename, "duplicate phase " + key);
+      results.keys.push_back(std::move(key));
+    }
+  }
+  return std::move(results);
+}
+
+/// Print the change from `baseline` to `candidate` and return true if it is a
+/// regression.
+static bool compare(double baseline, double candidate, double minDelta) {
+  double change = baseline ? (candidate - baseline) / baseline * 100 : 0;
+  bool regression =
+      candidate - baseline > minDelta && (!baseline || change > threshold);
+  llvm::outs() << llvm::format(" %10.2f %10.2f %+7.1f%%", baseline, candidate,
+                               change)
+               << (regression ? " !" : "  ");
+  return regression;
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv,
+                              "compare toy compilation benchmark results\n");
+
+  llvm::Expected<Results> baseline = readResults(baselineFilename);
+  if (!baseline) {
+    llvm::errs() << llvm::toString(baseline.takeError()) << "\n";
+    return 2;
+  }
+  llvm::Expected<Results> candidate = readResults(candidateFilename);
+  if (!candidate) {
+    llvm::errs() << llvm::toString(candidate.takeError()) << "\n";
+    return 2;
+  }
+
+  llvm::outs() << llvm::left_justify("file:phase", 40)
+               << llvm::right_justify("wall ms (old, new, change)", 33)
+               << llvm::right_justify("cpu ms (old, new, change)", 33)
+               << llvm::right_justify("peak rss KB (old, new, change)", 33)
+               << "\n";
+  unsigned numRegressions = 0;
+  for (const std::string &key : candidate->keys) {
+    auto it = baseline->measurements.find(key);
+    if (it == baseline->measurements.end()) {
+      llvm::outs() << llvm::left_justify(key, 40)
+                   << " missing from the baseline\n";
+      continue;
+    }
+    const Measurement &old = it->second;
+    Measurement now = candidate->measurements.lookup(key);
+    llvm::outs() << llvm::left_justify(key, 40);
+    bool regression = compare(old.wallTime, now.wallTime, minTimeDelta);
+    regression |= compare(old.cpuTime, now.cpuTime, minTimeDelta);
+    regression |= compare(old.peakRSS, now.peakRSS, minRSSDelta);
+    llvm::outs() << "\n";
+    numRegressions += regression;
+  }
+  for (const std::string &key : baseline->keys)
+    if (!candidate->measurements.count(key))
+      llvm::outs() << llvm::left_justify(key, 40)
+                   << " missing from the candidate\n";
+
+  if (numRegressions) {
+    llvm::outs() << numRegressions << " regression(s) above "
+                 << llvm::format("%.1f", threshold.getValue())
+                 << "% (marked with !)\n";
+    return 1;
+  }
+  llvm::outs() << "no regression above "
+               << llvm::format("%.1f", threshold.getValue()) << "%\n";
+  return 0;
+}
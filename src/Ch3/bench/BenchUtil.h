@@ -0,0 +1,50 @@
+//===- BenchUtil.h - Helpers shared by the Toy benchmarks -------*- C++ -*-===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the timing loop of the Toy benchmarks, along with the
+// `-repeat` option selecting its number of runs.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TOY_BENCH_BENCHUTIL_H
+#define TOY_BENCH_BENCHUTIL_H
+
+#include "llvm/Support/CommandLine.h"
+#include <chrono>
+
+/// Number of runs of each measurement, of which the fastest is reported. A
+/// benchmark can change the default with `setInitialValue()` before parsing
+/// the command line.
+inline llvm::cl::opt<unsigned>
+    repetitions("repeat", llvm::cl::desc("Number of runs per measurement"),
+                llvm::cl::init(5));
+
+/// Run `fn` the requested number of times and return the fastest run in
+/// seconds. `setup` is run untimed before each run.
+template <typename Fn, typename SetupFn>
+double timeBest(Fn fn, SetupFn setup) {
+  double best = 0;
+  for (unsigned i = 0; i < repetitions; ++i) {
+    setup();
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (i == 0 || elapsed.count() < best)
+      best = elapsed.count();
+  }
+  return best;
+}
+
+/// Run `fn` the requested number of times without any setup.
+template <typename Fn>
+double timeBest(Fn fn) {
+  return timeBest(fn, [] {});
+}
+
+#endif // TOY_BENCH_BENCHUTIL_H
@@ -0,0 +1,302 @@
+//===- CompileBench.cpp - Benchmark of the Toy compilation phases ---------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a benchmark running the phases of `toyc-ch3` in process
+// on a corpus of Toy files: reading, lexing and parsing, MLIR generation,
+// verification, optimization like `-opt` (inlining, shape inference and
+// canonicalization) and printing. The wall time, the CPU time and the peak
+// resident set size of every phase are written as JSON:
+//
+//   {
+//     "repeat": 5,
+//     "files": [
+//       {
+//         "file": "tests/transpose.toy",
+//         "bytes": 208,
+//         "phases": [
+//           {"name": "read", "wall_ms": 0.01, "cpu_ms": 0.01,
+//            "peak_rss_kb": 5120},
+//           ...
+//         ]
+//       }
+//     ]
+//   }
+//
+// The times are the median of the runs, and the peak resident set size is
+// the largest over the runs. Two results are compared by `toy-bench-compare`,
+// for instance to measure the cost of the locations with `-loc`.
+//
+//===----------------------------------------------------------------------===//
+
+#include "toy/AST.h"
+#include "toy/Dialect.h"
+#include "toy/Lexer.h"
+#include "toy/MLIRGen.h"
+#include "toy/Parser.h"
+#include "toy/Passes.h"
+
+#include "mlir/IR/AsmState.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/IR/Verifier.h"
+#include "mlir/Pass/PassManager.h"
+#include "mlir/Transforms/Passes.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <sys/resource.h>
+
+using namespace toy;
+namespace cl = llvm::cl;
+
+static cl::list<std::string> inputFilenames(cl::Positional, cl::OneOrMore,
+                                            cl::desc("<input toy files>"),
+                                            cl::value_desc("filename"));
+
+static cl::opt<std::string> outputFilename("o",
+                                           cl::desc("Output JSON filename"),
+                                           cl::value_desc("filename"),
+                                           cl::init("-"));
+
+static cl::opt<unsigned> repetitions("repeat",
+                                     cl::desc("Number of runs per file"),
+                                     cl::init(5));
+
+static cl::opt<LocationGranularity> locationGranularity(
+    "loc", cl::desc("Granularity of the locations of the emitted MLIR"),
+    cl::init(LocationGranularity::Full),
+    cl::values(clEnumValN(LocationGranularity::Full, "full",
+                          "the file, line and column of every operation")),
+    cl::values(clEnumValN(LocationGranularity::Function, "func",
+                          "the location of the enclosing function")),
+    cl::values(clEnumValN(LocationGranularity::None, "none",
+                          "unknown locations only")));
+
+static cl::opt<bool> parallelMLIRGen(
+    "parallel-mlirgen",
+    cl::desc("Emit the MLIR of the functions of a Toy file in parallel"));
+
+static cl::opt<uint64_t> literalResourceThreshold(
+    "literal-resource-threshold",
+    cl::desc("Size in bytes above which the data of literals is held in a "
+             "resource blob"),
+    cl::init(MLIRGenOptions().literalResourceThreshold));
+
+/// Reset the peak resident set size of the process to its current size, so
+/// that the next reading only covers the following phase. This is only
+/// supported on Linux, the peak covers the whole process elsewhere.
+static void resetPeakRSS() {
+#ifdef __linux__
+  std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+/// Return the peak resident set size of the process in KB.
+static uint64_t getPeakRSS() {
+#ifdef __linux__
+  // `VmHWM` is the high water mark reset above.
+  std::ifstream status("/proc/self/status");
+  for (std::string line; std::getline(status, line);) {
+    llvm::StringRef value(line);
+    uint64_t size;
+    if (value.consume_front("VmHWM:") &&
+        !value.trim().consumeInteger(10, size))
+      return size;
+  }
+#endif
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage))
+    return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+namespace {
+/// The measurements of a phase, over every run.
+struct Phase {
+  const char *name;
+  std::vector<double> wallTimes, cpuTimes;
+  uint64_t peakRSS = 0;
+};
+
+/// The phases, in the order they run.
+enum PhaseKind {
+  Phase_Read,
+  Phase_Parse,
+  Phase_MLIRGen,
+  Phase_Verify,
+  Phase_Canonicalize,
+  Phase_Print,
+  NumPhases
+};
+} // namespace
+
+/// Run `fn` and add its wall time, CPU time and peak resident set size to
+/// `phase`. Return the result of `fn`.
+template <typename Fn>
+static bool measure(Phase &phase, Fn fn) {
+  resetPeakRSS();
+  llvm::TimeRecord start = llvm::TimeRecord::getCurrentTime(/*Start=*/true);
+  bool success = fn();
+  llvm::TimeRecord end = llvm::TimeRecord::getCurrentTime(/*Start=*/false);
+  end -= start;
+  phase.wallTimes.push_back(end.getWallTime() * 1e3);
+  phase.cpuTimes.push_back(end.getProcessTime() * 1e3);
+  phase.peakRSS = std::max(phase.peakRSS, getPeakRSS());
+  return success;
+}
+
+static double getMedian(std::vector<double> values) {
+  llvm::sort(values);
+  size_t size = values.size();
+  return size % 2 ? values[size / 2]
+                  : (values[size / 2 - 1] + values[size / 2]) / 2;
+}
+
+/// Compile `filename` once, adding the measurements of each phase to
+/// `phases`. Return false on error.
+static bool compileFile(llvm::StringRef filename,
+                        llvm::MutableArrayRef<Phase> phases,
+                        uint64_t &numBytes) {
+  // Every run starts from a fresh context, so the attributes and types
+  // uniqued in previous runs aren't reused.
+  mlir::MLIRContext context;
+  context.getOrLoadDialect<mlir::toy::ToyDialect>();
+
+  std::shared_ptr<SourceFile> file;
+  if (!measure(phases[Phase_Read], [&] {
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> fileOrErr =
+            llvm::MemoryBuffer::getFile(filename);
+        if (std::error_code ec = fileOrErr.getError()) {
+          llvm::errs() << "Could not open input file " << filename << ": "
+                       << ec.message() << "\n";
+          return false;
+        }
+        numBytes = (*fileOrErr)->getBufferSize();
+        file = std::make_shared<SourceFile>(std::move(*fileOrErr));
+        return true;
+      }))
+    return false;
+
+  std::unique_ptr<ModuleAST> moduleAST;
+  if (!measure(phases[Phase_Parse], [&] {
+        LexerMemoryBuffer lexer(file);
+        Parser parser(lexer);
+        moduleAST = parser.parseModule();
+        return moduleAST != nullptr;
+      }))
+    return false;
+
+  // MLIRGen verifies the module it builds as well.
+  mlir::OwningOpRef<mlir::ModuleOp> module;
+  if (!measure(phases[Phase_MLIRGen], [&] {
+        MLIRGenOptions options;
+        options.locations = locationGranularity;
+        options.literalResourceThreshold = literalResourceThreshold;
+        options.parallel = parallelMLIRGen;
+        module = mlirGen(context, *moduleAST, options);
+        return bool(module);
+      }))
+    return false;
+  moduleAST.reset();
+
+  if (!measure(phases[Phase_Verify],
+               [&] { return mlir::succeeded(mlir::verify(*module)); }))
+    return false;
+
+  if (!measure(phases[Phase_Canonicalize], [&] {
+        mlir::PassManager pm(module.get()->getName());
+        if (mlir::failed(mlir::applyPassManagerCLOptions(pm)))
+          return false;
+        pm.addPass(mlir::createInlinerPass());
+        pm.addPass(mlir::createSymbolDCEPass());
+        mlir::OpPassManager &optPM = pm.nest<mlir::toy::FuncOp>();
+        optPM.addPass(mlir::toy::createShapeInferencePass());
+        optPM.addPass(mlir::createCanonicalizerPass());
+        return mlir::succeeded(pm.run(*module));
+      }))
+    return false;
+
+  return measure(phases[Phase_Print], [&] {
+    llvm::raw_null_ostream os;
+    module->print(os);
+    return true;
+  });
+}
+
+int main(int argc, char **argv) {
+  mlir::registerAsmPrinterCLOptions();
+  mlir::registerMLIRContextCLOptions();
+  mlir::registerPassManagerCLOptions();
+  cl::ParseCommandLineOptions(argc, argv, "toy compilation benchmark\n");
+  if (repetitions == 0) {
+    llvm::errs() << "-repeat must be at least 1\n";
+    return 1;
+  }
+
+  std::error_code ec;
+  llvm::raw_fd_ostream os(outputFilename, ec);
+  if (ec) {
+    llvm::errs() << "Could not open output file " << outputFilename << ": "
+                 << ec.message() << "\n";
+    return 1;
+  }
+
+  llvm::json::OStream json(os, /*IndentSize=*/2);
+  json.objectBegin();
+  json.attribute("repeat", repetitions.getValue());
+  json.attributeBegin("files");
+  json.arrayBegin();
+  for (const std::string &filename : inputFilenames) {
+    Phase phases[NumPhases] = {{"read"},         {"parse"},
+                               {"mlirgen"},      {"verify"},
+                               {"canonicalize"}, {"print"}};
+    uint64_t numBytes = 0;
+    for (unsigned i = 0; i < repetitions; ++i)
+      if (!compileFile(filename, phases, numBytes))
+        return 1;
+
+    json.object([&] {
+      json.attribute("file", filename);
+      json.attribute("bytes", numBytes);
+      json.attributeArray("phases", [&] {
+        for (const Phase &phase : phases) {
+          json.object([&] {
+            json.attribute("name", phase.name);
+            json.attribute("wall_ms", getMedian(phase.wallTimes));
+            json.attribute("cpu_ms", getMedian(phase.cpuTimes));
+            json.attribute("peak_rss_kb", phase.peakRSS);
+          });
+        }
+      });
+    });
+  }
+  json.arrayEnd();
+  json.attributeEnd();
+  json.objectEnd();
+  os << "\n";
+  return 0;
+}
@@ -0,0 +1,225 @@
+//===- FrontendBench.cpp - Throughput benchmark for the Toy frontend ------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a benchmark measuring each phase of the Toy frontend:
+// lexing with `LexerBuffer` and `LexerMemoryBuffer`, parsing a module and
+// dumping its AST. It runs on synthetic workloads stressing literals, calls and
+// deep expressions, or on the given input files, and reports the throughput of
+// each phase in bytes, tokens and AST nodes per second.
+//
+//===----------------------------------------------------------------------===//
+
+#include "BenchUtil.h"
+#include "toy/AST.h"
+#include "toy/Lexer.h"
+#include "toy/Parser.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace toy;
+namespace cl = llvm::cl;
+
+static cl::list<std::string>
+    inputFilenames(cl::Positional,
+                   cl::desc("<input toy files> (synthetic inputs by default)"),
+                   cl::value_desc("filename"));
+
+static cl::opt<unsigned> inputSizeMB(
+    "size", cl::desc("Size in MB of each synthetic input"), cl::init(16));
+
+/// Build an input made of large tensor literals, like embedded weights.
+static std::string buildLiteralInput(size_t size) {
+  std::string input;
+  input.reserve(size + 4096);
+  for (unsigned func = 0; input.size() < size; ++func) {
+    input += "def literals" + std::to_string(func) + "() {\n";
+    input += "  var w<32, 32> = [\n";
+    for (unsigned row = 0; row < 32; ++row) {
+      input += "    [";
+      for (unsigned col = 0; col < 32; ++col) {
+        input += std::to_string((row * 32 + col + func) % 1000) + ".5";
+        input += col == 31 ? "]" : ", ";
+      }
+      input += row == 31 ? "\n" : ",\n";
+    }
+    input += "  ];\n  print(w);\n}\n\n";
+  }
+  return input;
+}
+
+/// Build an input made of many small functions calling each other with nested
+/// call arguments.
+static std::string buildCallInput(size_t size) {
+  std::string input;
+  input.reserve(size + 4096);
+  for (unsigned func = 0; input.size() < size; ++func) {
+    std::string callee = "calls" + std::to_string(func == 0 ? 0 : func - 1);
+    input += "def calls" + std::to_string(func) + "(a, b) {\n";
+    for (unsigned stmt = 0; stmt < 8; ++stmt) {
+      input += "  var v" + std::to_string(stmt) + " = " + callee +
+               "(transpose(a), " + callee + "(b, transpose(" + callee +
+               "(a, b))));\n";
+    }
+    input += "  print(v7);\n  return " + callee + "(v0, v7);\n}\n\n";
+  }
+  return input;
+}
+
+/// Build an input made of long chains of binary operators and deeply nested
+/// parentheses, like machine-generated expressions.
+static std::string buildDeepInput(size_t size) {
+  std::string input;
+  input.reserve(size + 65536);
+  for (unsigned func = 0; input.size() < size; ++func) {
+    input += "def deep" + std::to_string(func) + "(a, b) {\n  var c = a";
+    for (unsigned i = 0; i < 2000; ++i)
+      input += i % 3 ? " + b" : " * a";
+    input += ";\n  return ";
+    for (unsigned i = 0; i < 500; ++i)
+      input += "a * (b + (";
+    input += "c";
+    for (unsigned i = 0; i < 500; ++i)
+      input += "))";
+    input += ";\n}\n\n";
+  }
+  return input;
+}
+
+/// Return the number of nodes in the AST of `module`, counting functions,
+/// prototypes, parameters and expressions.
+static size_t countNodes(ModuleAST &module) {
+  size_t count = 0;
+  llvm::SmallVector<ExprAST *, 64> worklist;
+  for (FunctionAST &function : module) {
+    count += 2 + function.getProto()->getArgs().size();
+    worklist.append(function.getBody()->begin(), function.getBody()->end());
+    while (!worklist.empty()) {
+      llvm::MutableArrayRef<ExprAST *> operands =
+          getOperands(worklist.pop_back_val());
+      worklist.append(operands.begin(), operands.end());
+      ++count;
+    }
+  }
+  return count;
+}
+
+/// Return the number of tokens in the stream of `lexer`.
+static size_t countTokens(Lexer &lexer) {
+  size_t count = 0;
+  for (Token tok = lexer.getNextToken(); tok != tok_eof;
+       tok = lexer.getNextToken())
+    ++count;
+  return count;
+}
+
+namespace {
+/// The amount of work in an input, each phase's throughput is reported against.
+struct Workload {
+  size_t numBytes = 0;
+  size_t numTokens = 0;
+  size_t numNodes = 0;
+};
+} // namespace
+
+static void report(llvm::StringRef phase, const Workload &workload,
+                   double seconds) {
+  llvm::outs() << llvm::format(
+      "  %-24s %10.1f MB/s %10.2f Mtok/s %10.2f Mnode/s\n", phase.str().c_str(),
+      workload.numBytes / seconds / 1e6, workload.numTokens / seconds / 1e6,
+      workload.numNodes / seconds / 1e6);
+}
+
+/// Benchmark every phase of the frontend on `buffer`, and return false if it
+/// fails to parse.
+static bool runBenchmarks(llvm::StringRef name, llvm::StringRef buffer) {
+  // Parse once untimed, to check the input and measure the workload.
+  Workload workload;
+  workload.numBytes = buffer.size();
+  {
+    LexerMemoryBuffer lexer(buffer, name.str());
+    workload.numTokens = countTokens(lexer);
+  }
+  std::unique_ptr<ModuleAST> module;
+  {
+    LexerMemoryBuffer lexer(buffer, name.str());
+    Parser parser(lexer);
+    module = parser.parseModule();
+  }
+  if (!module) {
+    llvm::errs() << name << ": parse error\n";
+    return false;
+  }
+  workload.numNodes = countNodes(*module);
+  llvm::outs() << "workload: " << name << ", " << workload.numBytes
+               << " bytes, " << workload.numTokens << " tokens, "
+               << workload.numNodes << " AST nodes\n";
+
+  report("lex/LexerBuffer", workload, timeBest([&] {
+           LexerBuffer lexer(buffer.begin(), buffer.end(), name.str());
+           countTokens(lexer);
+         }));
+  report("lex/LexerMemoryBuffer", workload, timeBest([&] {
+           LexerMemoryBuffer lexer(buffer, name.str());
+           countTokens(lexer);
+         }));
+
+  // Only the parsing is timed: the previous module is released beforehand.
+  double parseTime = timeBest(
+      [&] {
+        LexerMemoryBuffer lexer(buffer, name.str());
+        Parser parser(lexer);
+        module = parser.parseModule();
+      },
+      [&] { module.reset(); });
+  report("parse", workload, parseTime);
+
+  report("dump", workload, timeBest([&] {
+           llvm::raw_null_ostream os;
+           dump(*module, os);
+         }));
+  return true;
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "toy frontend benchmark\n");
+  if (repetitions == 0) {
+    llvm::errs() << "-repeat must be at least 1\n";
+    return 1;
+  }
+
+  bool success = true;
+  if (inputFilenames.empty()) {
+    size_t size = size_t(inputSizeMB) << 20;
+    success &= runBenchmarks("literals", buildLiteralInput(size));
+    success &= runBenchmarks("calls", buildCallInput(size));
+    success &= runBenchmarks("deep", buildDeepInput(size));
+    return success ? 0 : 1;
+  }
+
+  for (const std::string &filename : inputFilenames) {
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> fileOrErr =
+        llvm::MemoryBuffer::getFileOrSTDIN(filename);
+    if (std::error_code ec = fileOrErr.getError()) {
+      llvm::errs() << "Could not open input file " << filename << ": "
+                   << ec.message() << "\n";
+      return 1;
+    }
+    success &= runBenchmarks(filename, (*fileOrErr)->getBuffer());
+  }
+  return success ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+//===- LexerBench.cpp - Throughput benchmark for the Toy lexer ------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a small benchmark measuring the throughput of the Toy
+// lexer: the line based `LexerBuffer` against the in place `LexerMemoryBuffer`
+// with each of the available scanning kernels.
+//
+//===----------------------------------------------------------------------===//
+
+#include "BenchUtil.h"
+#include "toy/Lexer.h"
+#include "toy/LexerScan.h"
+
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+using namespace toy;
+namespace cl = llvm::cl;
+
+static cl::opt<std::string>
+    inputFilename(cl::Positional,
+                  cl::desc("<input toy file> (a synthetic input by default)"),
+                  cl::init(""), cl::value_desc("filename"));
+
+static cl::opt<unsigned> inputSizeMB(
+    "size", cl::desc("Size in MB of the synthetic input"), cl::init(64));
+
+/// Build an input shaped like machine-generated Toy sources: comment banners,
+/// deep indentation and tensor literals made of long numbers.
+static std::string buildSyntheticInput(size_t size) {
+  std::string input;
+  input.reserve(size + 4096);
+  for (unsigned func = 0; input.size() < size; ++func) {
+    input += "#################################################################"
+             "###############\n";
+    input += "# Generated function " + std::to_string(func) + "\n";
+    input += "#################################################################"
+             "###############\n";
+    input += "def func" + std::to_string(func) + "(a, b) {\n";
+    input += "        var c<16, 8> = [\n";
+    for (unsigned row = 0; row < 16; ++row) {
+      input += "                ";
+      for (unsigned col = 0; col < 8; ++col) {
+        input += std::to_string(row * 1000003 + col * 7919 + func);
+        input += row == 15 && col == 7 ? ".000123456789" : ".000123456789, ";
+      }
+      input += "\n";
+    }
+    input += "        ];\n";
+    input += "        return transpose(a) * transpose(b) + c;\n";
+    input += "}\n\n";
+  }
+  return input;
+}
+
+namespace {
+/// Result of lexing a whole buffer: the number of tokens and a checksum used to
+/// make sure every lexer saw the same stream.
+struct LexResult {
+  size_t numTokens = 0;
+  double checksum = 0;
+  /// Location of the end of the input, checked to catch offsets or line
+  /// numbers overflowing on inputs larger than 4 GiB.
+  uint64_t endOffset = 0;
+  LineColumn endLineCol = {0, 0};
+};
+} // namespace
+
+static LexResult lexAll(Lexer &lexer) {
+  LexResult result;
+  for (Token tok = lexer.getNextToken(); tok != tok_eof;
+       tok = lexer.getNextToken()) {
+    ++result.numTokens;
+    if (tok == tok_number)
+      result.checksum += lexer.getValue();
+    else
+      result.checksum += static_cast<int>(tok);
+  }
+  return result;
+}
+
+template <typename CreateLexerFn>
+static bool runBenchmark(llvm::StringRef name, llvm::StringRef buffer,
+                         CreateLexerFn createLexer,
+                         std::optional<LexResult> &reference) {
+  LexResult result;
+  std::unique_ptr<Lexer> lexer;
+  double best = timeBest([&] {
+    lexer = createLexer();
+    result = lexAll(*lexer);
+  });
+  // Decoding the end location may build the line table, so it isn't timed.
+  Location end = lexer->getLastLocation();
+  result.endOffset = end.offset;
+  result.endLineCol = lexer->getSourceFile()->getLineColumn(end);
+
+  llvm::outs() << llvm::format("%-24s %10.1f MB/s %10.2f Mtok/s\n",
+                               name.str().c_str(),
+                               buffer.size() / best / 1e6,
+                               result.numTokens / best / 1e6);
+  if (!reference) {
+    reference = result;
+    return true;
+  }
+  if (reference->numTokens != result.numTokens ||
+      reference->checksum != result.checksum) {
+    llvm::errs() << name << ": token stream differs from the reference lexer\n";
+    return false;
+  }
+  if (reference->endOffset != result.endOffset ||
+      reference->endLineCol.line != result.endLineCol.line ||
+      reference->endLineCol.col != result.endLineCol.col) {
+    llvm::errs() << name << ": end location differs from the reference lexer\n";
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "toy lexer benchmark\n");
+  if (repetitions == 0) {
+    llvm::errs() << "-repeat must be at least 1\n";
+    return 1;
+  }
+
+  std::unique_ptr<llvm::MemoryBuffer> input;
+  if (inputFilename.empty()) {
+    input = llvm::MemoryBuffer::getMemBufferCopy(
+        buildSyntheticInput(size_t(inputSizeMB) << 20), "synthetic");
+  } else {
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> fileOrErr =
+        llvm::MemoryBuffer::getFileOrSTDIN(inputFilename);
+    if (std::error_code ec = fileOrErr.getError()) {
+      llvm::errs() << "Could not open input file: " << ec.message() << "\n";
+      return 1;
+    }
+    input = std::move(*fileOrErr);
+  }
+  llvm::StringRef buffer = input->getBuffer();
+  llvm::outs() << "input: " << input->getBufferIdentifier() << ", "
+               << buffer.size() << " bytes\n";
+
+  std::optional<LexResult> reference;
+  bool success = runBenchmark(
+      "LexerBuffer", buffer,
+      [&] {
+        return std::make_unique<LexerBuffer>(buffer.begin(), buffer.end(),
+                                             "bench");
+      },
+      reference);
+  const ScanISA isas[] = {ScanISA::Scalar, ScanISA::SSE2, ScanISA::AVX2};
+  for (ScanISA isa : isas) {
+    const ScanKernels *kernels = getScanKernels(isa);
+    if (!kernels) {
+      llvm::outs() << "LexerMemoryBuffer/" << getScanISAName(isa)
+                   << ": not supported on this host\n";
+      continue;
+    }
+    success &= runBenchmark(
+        (llvm::Twine("LexerMemoryBuffer/") + getScanISAName(isa)).str(),
+        buffer,
+        [&] {
+          return std::make_unique<LexerMemoryBuffer>(buffer, "bench", *kernels);
+        },
+        reference);
+  }
+  return success ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+//===- SaveBench.cpp - Benchmark of the Toy tensor output paths -----------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a small benchmark comparing the two ways a Toy program
+// can output a tensor: formatting every value as text like `toy.print`, or
+// writing the values in binary to a `.npy` file like `toy.save`. The `.npy`
+// file is also checked to load back as the tensor written.
+//
+//===----------------------------------------------------------------------===//
+
+#include "BenchUtil.h"
+#include "toy/Npy.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <vector>
+
+using namespace toy;
+namespace cl = llvm::cl;
+
+static cl::opt<uint64_t>
+    numElements("elements", cl::desc("Number of elements of the tensor"),
+                cl::init(100'000'000));
+
+static cl::opt<unsigned> rowSize("row",
+                                 cl::desc("Size of the innermost dimension"),
+                                 cl::init(1000));
+
+static cl::opt<std::string>
+    outputDir("dir", cl::desc("Directory to write the outputs to"),
+              cl::init(""), cl::value_desc("directory"));
+
+/// Write the tensor as text the way `toy.print` does once lowered: each value
+/// formatted with "%f ", and a new line at the end of each row.
+static llvm::Error printTensor(llvm::StringRef path,
+                               llvm::ArrayRef<double> data) {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec);
+  if (ec)
+    return llvm::errorCodeToError(ec);
+  for (size_t i = 0, e = data.size(); i != e; ++i) {
+    os << llvm::format("%f ", data[i]);
+    if ((i + 1) % rowSize == 0)
+      os << "\n";
+  }
+  os.close();
+  if (os.has_error())
+    return llvm::errorCodeToError(os.error());
+  return llvm::Error::success();
+}
+
+/// Write the tensor to the `.npy` file at `path`, and check that reading it back
+/// gives the same tensor.
+static llvm::Error checkNpyRoundTrip(llvm::StringRef path,
+                                     llvm::ArrayRef<int64_t> shape,
+                                     llvm::ArrayRef<double> data) {
+  if (llvm::Error error = writeNpyFile(path, shape, data))
+    return error;
+  llvm::Expected<NpyArray> array = readNpyFile(path);
+  if (!array)
+    return array.takeError();
+  bool same = llvm::ArrayRef(array->shape) == shape && array->data == data;
+  // Release the mapping before removing the file.
+  array->buffer.reset();
+  llvm::sys::fs::remove(path);
+  if (!same)
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "the file doesn't load back as the tensor");
+  return llvm::Error::success();
+}
+
+template <typename WriteFn>
+static bool runBenchmark(llvm::StringRef name, llvm::StringRef path,
+                         size_t dataSize, WriteFn write) {
+  // The runs after a failed one do nothing.
+  llvm::Error error = llvm::Error::success();
+  double best = timeBest([&] {
+    if (!error)
+      error = write();
+  });
+  if (error) {
+    llvm::errs() << name << ": " << llvm::toString(std::move(error)) << "\n";
+    return false;
+  }
+
+  uint64_t fileSize = 0;
+  llvm::sys::fs::file_size(path, fileSize);
+  llvm::sys::fs::remove(path);
+  llvm::outs() << llvm::format("%-12s %10.3f s %10.1f MB/s %12llu bytes\n",
+                               name.str().c_str(), best, dataSize / best / 1e6,
+                               (unsigned long long)fileSize);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  // Each run writes the whole tensor, so fewer runs are made by default.
+  repetitions.setInitialValue(3);
+  cl::ParseCommandLineOptions(argc, argv, "toy tensor output benchmark\n");
+  if (repetitions == 0 || rowSize == 0 || numElements % rowSize) {
+    llvm::errs() << "-repeat and -row must be at least 1, and -row must divide "
+                    "-elements\n";
+    return 1;
+  }
+
+  llvm::SmallString<128> dir(outputDir);
+  if (dir.empty())
+    llvm::sys::path::system_temp_directory(/*ErasedOnReboot=*/true, dir);
+  llvm::SmallString<128> textPath(dir), npyPath(dir);
+  llvm::sys::path::append(textPath, "toy-save-bench.txt");
+  llvm::sys::path::append(npyPath, "toy-save-bench.npy");
+
+  std::vector<double> data(numElements);
+  for (size_t i = 0, e = data.size(); i != e; ++i)
+    data[i] = static_cast<double>(i % 1000003) * 0.25;
+  const int64_t shape[] = {static_cast<int64_t>(numElements / rowSize),
+                           static_cast<int64_t>(rowSize)};
+  size_t dataSize = data.size() * sizeof(double);
+  llvm::outs() << "tensor: " << shape[0] << "x" << shape[1] << "xf64, "
+               << dataSize << " bytes\n";
+
+  bool success = runBenchmark("print (text)", textPath, dataSize,
+                              [&] { return printTensor(textPath, data); });
+  success &= runBenchmark("save (npy)", npyPath, dataSize, [&] {
+    return writeNpyFile(npyPath, shape, data);
+  });
+  if (llvm::Error error = checkNpyRoundTrip(npyPath, shape, data)) {
+    llvm::errs() << "save (npy): " << llvm::toString(std::move(error)) << "\n";
+    success = false;
+  }
+  return success ? 0 : 1;
+}
@@ -0,0 +1,390 @@
+//===- ToyGen.cpp - Synthetic Toy program generator -----------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a generator of random Toy modules, used to stress the
+// parser, MLIRGen and the canonicalizer with programs larger than the examples.
+// The size and shape of the programs are tuned with command line options, and
+// the same seed always produces the same module.
+//
+// The generated modules only use the base language understood by every
+// chapter: functions, variables with optional shapes, tensor literals, the
+// arithmetic operators and the `transpose` and `print` builtins. The shapes
+// are tracked so that the operands of every operator agree, and every
+// function takes and returns tensors of the same shape, making the modules
+// valid for shape inference as well.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace cl = llvm::cl;
+
+static cl::opt<std::string> outputFilename("o",
+                                           cl::desc("Output filename"),
+                                           cl::value_desc("filename"),
+                                           cl::init("-"));
+
+static cl::opt<uint64_t> seed("seed", cl::desc("Seed of the generator"),
+                              cl::init(1));
+
+static cl::opt<unsigned> numFunctions("functions",
+                                      cl::desc("Number of functions besides "
+                                               "main"),
+                                      cl::init(16));
+
+static cl::opt<unsigned> callDepth(
+    "call-depth",
+    cl::desc("Depth of the call graph: functions at each level call the "
+             "functions of the level below"),
+    cl::init(4));
+
+static cl::opt<unsigned> numStatements("statements",
+                                       cl::desc("Number of variables declared "
+                                                "in each function"),
+                                       cl::init(4));
+
+static cl::opt<unsigned> literalSize(
+    "literal-size", cl::desc("Number of elements of the tensors"),
+    cl::init(6));
+
+static cl::opt<unsigned> exprDepth("expr-depth",
+                                   cl::desc("Nesting depth of the expressions"),
+                                   cl::init(4));
+
+static cl::opt<double> transposeDensity(
+    "transpose-density",
+    cl::desc("Probability for an operand to be transposed"), cl::init(0.25));
+
+static cl::opt<double> reshapeDensity(
+    "reshape-density",
+    cl::desc("Probability for a variable to be declared with a shape"),
+    cl::init(0.25));
+
+static cl::opt<double> duplicateRate(
+    "duplicate-rate",
+    cl::desc("Probability for an expression to repeat an earlier one"),
+    cl::init(0.1));
+
+/// The deepest expressions that may be repeated.
+static constexpr unsigned maxRepeatedDepth = 8;
+
+namespace {
+
+/// The shapes a tensor can have: all of them hold `literalSize` elements, so
+/// any tensor can be reshaped into another.
+enum Shape : unsigned { Shape_Matrix, Shape_Transposed, Shape_Flat, NumShapes };
+
+/// A variable in scope and its shape.
+struct Variable {
+  std::string name;
+  Shape shape;
+};
+
+/// Generate a random module. The random numbers are drawn from a Mersenne
+/// twister directly rather than through the standard distributions, whose
+/// results differ between implementations, so that a seed gives the same
+/// module on every platform.
+class ToyGenerator {
+public:
+  ToyGenerator(llvm::raw_ostream &os) : os(os), rng(seed) {
+    // Lay the elements out as a matrix as square as possible.
+    rows = 1;
+    for (unsigned i = 1; uint64_t(i) * i <= literalSize; ++i)
+      if (literalSize % i == 0)
+        rows = i;
+    cols = literalSize / rows;
+  }
+
+  void generate() {
+    unsigned depth = std::max(1u, std::min(callDepth.getValue(),
+                                           numFunctions.getValue()));
+    // The functions are spread over the levels of the call graph and are
+    // emitted bottom up, so that each one only calls functions defined
+    // before it.
+    levels.resize(depth);
+    for (unsigned i = 0; i < numFunctions; ++i)
+      levels[i * depth / numFunctions].push_back(
+          {"f" + std::to_string(i), 1 + unsigned(below(3))});
+    for (unsigned level = 0; level < depth; ++level)
+      for (const Function &function : levels[level])
+        generateFunction(function, level);
+    generateMain();
+  }
+
+private:
+  /// A generated function and the number of its parameters.
+  struct Function {
+    std::string name;
+    unsigned numParams;
+  };
+
+  /// Return a random number in [0, n).
+  uint64_t below(uint64_t n) { return rng() % n; }
+
+  /// Return true with probability `p`.
+  bool chance(double p) { return (rng() >> 11) * 0x1.0p-53 < p; }
+
+  static Shape getTransposed(Shape shape) {
+    return shape == Shape_Matrix ? Shape_Transposed : Shape_Matrix;
+  }
+
+  void printShape(Shape shape) {
+    switch (shape) {
+    case Shape_Matrix:
+      os << "<" << rows << ", " << cols << ">";
+      break;
+    case Shape_Transposed:
+      os << "<" << cols << ", " << rows << ">";
+      break;
+    default:
+      os << "<" << literalSize << ">";
+      break;
+    }
+  }
+
+  std::string getLiteral(Shape shape) {
+    std::string literal = "[";
+    unsigned outer = shape == Shape_Flat ? 1
+                     : shape == Shape_Matrix ? rows
+                                             : cols;
+    unsigned inner = literalSize / outer;
+    for (unsigned i = 0; i < outer; ++i) {
+      if (i)
+        literal += ", ";
+      if (shape != Shape_Flat)
+        literal += "[";
+      for (unsigned j = 0; j < inner; ++j) {
+        if (j)
+          literal += ", ";
+        literal += std::to_string(below(1000));
+        if (chance(0.5))
+          literal += ".5";
+      }
+      if (shape != Shape_Flat)
+        literal += "]";
+    }
+    return literal + "]";
+  }
+
+  /// Return a leaf of the given shape: a variable, a transposed variable, or a
+  /// literal when no variable fits.
+  std::string getLeaf(Shape shape) {
+    llvm::SmallVector<const Variable *, 16> direct, transposed;
+    for (const Variable &var : scope) {
+      if (var.shape == shape)
+        direct.push_back(&var);
+      else if (shape != Shape_Flat && var.shape == getTransposed(shape))
+        transposed.push_back(&var);
+    }
+    if (!transposed.empty() && (direct.empty() || chance(transposeDensity)))
+      return "transpose(" + transposed[below(transposed.size())]->name + ")";
+    if (!direct.empty())
+      return direct[below(direct.size())]->name;
+    return getLiteral(shape);
+  }
+
+  /// Return an expression of the given shape nested `depth` levels deep. The
+  /// nesting is carried by a single operand of each operator, the others are
+  /// kept shallow so that the size of the expression grows linearly with the
+  /// depth. That operand is generated by a loop rather than recursively, as
+  /// the depth may be larger than the stack allows.
+  std::string getExpr(Shape shape, unsigned depth) {
+    // The text around the deep operand at each level.
+    struct Level {
+      std::string prefix, suffix;
+      Shape shape;
+      unsigned depth;
+    };
+    std::vector<Level> spine;
+    std::string expr;
+    while (true) {
+      if (depth == 0) {
+        expr = getLeaf(shape);
+        break;
+      }
+      if (depth <= maxRepeatedDepth) {
+        std::vector<std::string> &pool = duplicates[shape][depth - 1];
+        if (!pool.empty() && chance(duplicateRate)) {
+          expr = pool[below(pool.size())];
+          break;
+        }
+      }
+
+      Level level{"", "", shape, depth--};
+      if (shape == Shape_Matrix && !callees.empty() && chance(0.25)) {
+        std::tie(level.prefix, level.suffix) = getCall(depth);
+      } else if (shape != Shape_Flat && chance(transposeDensity)) {
+        level.prefix = "transpose(";
+        level.suffix = ")";
+        shape = getTransposed(shape);
+      } else {
+        std::string op = chance(0.5) ? " + " : " * ";
+        std::string other = getExpr(shape, below(std::min(depth + 1, 3u)));
+        if (chance(0.5)) {
+          level.prefix = "(" + other + op;
+          level.suffix = ")";
+        } else {
+          level.prefix = "(";
+          level.suffix = op + other + ")";
+        }
+      }
+      spine.push_back(std::move(level));
+    }
+
+    // Remember the innermost levels to repeat them, while the others are
+    // wrapped around them in one go.
+    while (!spine.empty() && spine.back().depth <= maxRepeatedDepth) {
+      Level &level = spine.back();
+      expr = level.prefix + expr + level.suffix;
+      std::vector<std::string> &pool = duplicates[level.shape][level.depth - 1];
+      if (pool.size() < 16)
+        pool.push_back(expr);
+      else
+        pool[below(pool.size())] = expr;
+      spine.pop_back();
+    }
+    std::string result;
+    for (const Level &level : spine)
+      result += level.prefix;
+    result += expr;
+    for (const Level &level : llvm::reverse(spine))
+      result += level.suffix;
+    return result;
+  }
+
+  /// Return the text before and after the deep argument of a call to one of
+  /// the callees of the current function, the other arguments being kept
+  /// shallow.
+  std::pair<std::string, std::string> getCall(unsigned depth) {
+    const Function &callee = callees[below(callees.size())];
+    unsigned deepArg = below(callee.numParams);
+    unsigned shallowDepth = std::min(depth + 1, 3u);
+    std::string prefix = callee.name + "(", suffix;
+    for (unsigned i = 0; i < deepArg; ++i)
+      prefix += getExpr(Shape_Matrix, below(shallowDepth)) + ", ";
+    for (unsigned i = deepArg + 1; i < callee.numParams; ++i)
+      suffix += ", " + getExpr(Shape_Matrix, below(shallowDepth));
+    return {prefix, suffix + ")"};
+  }
+
+  /// Emit `var name<shape> = expr;`, where the shape is spelled out with
+  /// probability `reshapeDensity` and may differ from the one of the
+  /// expression.
+  void declareVariable(std::string name, std::string expr, Shape shape) {
+    os << "  var " << name;
+    if (chance(reshapeDensity)) {
+      shape = Shape(below(NumShapes));
+      printShape(shape);
+    }
+    os << " = " << expr << ";\n";
+    scope.push_back({std::move(name), shape});
+  }
+
+  void generateFunction(const Function &function, unsigned level) {
+    callees = level ? llvm::ArrayRef<Function>(levels[level - 1])
+                    : llvm::ArrayRef<Function>();
+    scope.clear();
+    for (auto &pools : duplicates)
+      for (std::vector<std::string> &pool : pools)
+        pool.clear();
+
+    os << "def " << function.name << "(";
+    for (unsigned i = 0; i < function.numParams; ++i) {
+      std::string name = "a" + std::to_string(i);
+      os << (i ? ", " : "") << name;
+      scope.push_back({name, Shape_Matrix});
+    }
+    os << ") {\n";
+    // Make sure the call graph is as deep as requested.
+    if (level) {
+      auto [prefix, suffix] = getCall(exprDepth);
+      declareVariable("c", prefix + getExpr(Shape_Matrix, exprDepth) + suffix,
+                      Shape_Matrix);
+    }
+    for (unsigned i = 0; i < numStatements; ++i) {
+      Shape shape = Shape(below(NumShapes));
+      declareVariable("v" + std::to_string(i), getExpr(shape, exprDepth),
+                      shape);
+    }
+    os << "  return " << getExpr(Shape_Matrix, exprDepth) << ";\n}\n\n";
+  }
+
+  /// Emit `main`, calling every function of the last level with literals and
+  /// printing the results.
+  void generateMain() {
+    os << "def main() {\n";
+    for (unsigned i = 0; i < 3; ++i) {
+      os << "  var x" << i;
+      printShape(Shape_Matrix);
+      os << " = " << getLiteral(Shape_Matrix) << ";\n";
+    }
+    unsigned i = 0;
+    for (const Function &function : levels.back()) {
+      os << "  var r" << i << " = " << function.name << "(";
+      for (unsigned param = 0; param < function.numParams; ++param)
+        os << (param ? ", " : "") << "x" << below(3);
+      os << ");\n  print(r" << i++ << ");\n";
+    }
+    os << "}\n";
+  }
+
+  llvm::raw_ostream &os;
+  std::mt19937_64 rng;
+  unsigned rows, cols;
+
+  /// The functions of each level of the call graph.
+  std::vector<std::vector<Function>> levels;
+
+  /// The functions the current function may call.
+  llvm::ArrayRef<Function> callees;
+
+  /// The variables of the current function.
+  std::vector<Variable> scope;
+
+  /// Expressions of the current function for each shape and depth, to be
+  /// repeated. Only shallow expressions are repeated, so that repeated
+  /// expressions don't pile up into each other.
+  std::vector<std::string> duplicates[NumShapes][maxRepeatedDepth];
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "toy program generator\n");
+  if (literalSize == 0) {
+    llvm::errs() << "-literal-size must be at least 1\n";
+    return 1;
+  }
+
+  std::error_code ec;
+  llvm::raw_fd_ostream os(outputFilename, ec);
+  if (ec) {
+    llvm::errs() << "Could not open output file " << outputFilename << ": "
+                 << ec.message() << "\n";
+    return 1;
+  }
+  // Record the command line, to regenerate the module.
+  os << "# Generated by:";
+  for (int i = 0; i < argc; ++i)
+    os << " " << argv[i];
+  os << "\n\n";
+  ToyGenerator(os).generate();
+  return 0;
+}
@@ -0,0 +1,191 @@
+//===- VerifyBench.cpp - Scaling benchmark of the Toy op verifiers --------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a benchmark checking that the verification of Toy
+// modules stays linear in their size. Modules of doubling sizes are built in
+// memory for a few workloads: many small functions, a single long function,
+// and many constants. The time per operation of `mlir::verify` is reported
+// for every size, which exercises the verifiers of `toy.constant`,
+// `toy.transpose` and `toy.return` among others.
+//
+// The tool exits with 1 when the time per operation of a workload grows by
+// more than a factor from its smallest module to its largest, so that it can
+// gate changes.
+//
+//===----------------------------------------------------------------------===//
+
+#include "BenchUtil.h"
+#include "toy/Dialect.h"
+
+#include "mlir/IR/Builders.h"
+#include "mlir/IR/BuiltinAttributes.h"
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/IR/BuiltinTypes.h"
+#include "mlir/IR/MLIRContext.h"
+#include "mlir/IR/Verifier.h"
+
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+
+using namespace mlir::toy;
+namespace cl = llvm::cl;
+
+static cl::opt<unsigned>
+    numOps("ops", cl::desc("Number of operations of the smallest modules"),
+           cl::init(1 << 16));
+
+static cl::opt<unsigned> numSizes("sizes",
+                                  cl::desc("Number of doubling module sizes"),
+                                  cl::init(4));
+
+static cl::opt<double> maxGrowth(
+    "max-growth",
+    cl::desc("Largest growth of the time per operation from the smallest "
+             "module to the largest"),
+    cl::init(1.5));
+
+/// A function building the body of a module with about `numOps` operations.
+using BuildFn = llvm::function_ref<void(mlir::OpBuilder &, size_t numOps)>;
+
+static mlir::RankedTensorType getTensorType(mlir::OpBuilder &builder,
+                                            llvm::ArrayRef<int64_t> shape) {
+  return mlir::RankedTensorType::get(shape, builder.getF64Type());
+}
+
+/// Create a function without arguments returning a tensor of type
+/// `resultType` at the insertion point.
+static FuncOp createFunction(mlir::OpBuilder &builder, llvm::StringRef name,
+                             mlir::Type resultType) {
+  return builder.create<FuncOp>(
+      builder.getUnknownLoc(), name,
+      builder.getFunctionType(std::nullopt, resultType));
+}
+
+/// Many small functions, each one transposing, adding and multiplying a
+/// constant before returning it.
+static void buildFunctions(mlir::OpBuilder &builder, size_t numOps) {
+  mlir::Location loc = builder.getUnknownLoc();
+  auto inputType = getTensorType(builder, {2, 3});
+  auto resultType = getTensorType(builder, {3, 2});
+  for (size_t i = 0; i < numOps / 5; ++i) {
+    FuncOp function =
+        createFunction(builder, "f" + std::to_string(i), resultType);
+    mlir::OpBuilder::InsertionGuard guard(builder);
+    builder.setInsertionPointToStart(&function.front());
+    mlir::Value value = builder.create<ConstantOp>(
+        loc, mlir::DenseElementsAttr::get(inputType, double(i)));
+    value = builder.create<TransposeOp>(loc, resultType, value);
+    value = builder.create<AddOp>(loc, resultType, value, value);
+    value = builder.create<MulOp>(loc, resultType, value, value);
+    builder.create<ReturnOp>(loc, value);
+  }
+}
+
+/// A single function transposing a value back and forth and accumulating it.
+static void buildLongFunction(mlir::OpBuilder &builder, size_t numOps) {
+  mlir::Location loc = builder.getUnknownLoc();
+  auto type = getTensorType(builder, {2, 3});
+  auto transposedType = getTensorType(builder, {3, 2});
+  FuncOp function = createFunction(builder, "long", type);
+  mlir::OpBuilder::InsertionGuard guard(builder);
+  builder.setInsertionPointToStart(&function.front());
+  mlir::Value value =
+      builder.create<ConstantOp>(loc, mlir::DenseElementsAttr::get(type, 1.0));
+  for (size_t i = 0; i < numOps / 3; ++i) {
+    mlir::Value transposed =
+        builder.create<TransposeOp>(loc, transposedType, value);
+    transposed = builder.create<TransposeOp>(loc, type, transposed);
+    value = builder.create<AddOp>(loc, type, value, transposed);
+  }
+  builder.create<ReturnOp>(loc, value);
+}
+
+/// A single function with many distinct constants of rank 4.
+static void buildConstants(mlir::OpBuilder &builder, size_t numOps) {
+  mlir::Location loc = builder.getUnknownLoc();
+  auto type = getTensorType(builder, {2, 2, 2, 2});
+  FuncOp function = createFunction(builder, "constants", type);
+  mlir::OpBuilder::InsertionGuard guard(builder);
+  builder.setInsertionPointToStart(&function.front());
+  mlir::Value value;
+  for (size_t i = 0; i < numOps; ++i)
+    value = builder.create<ConstantOp>(
+        loc, mlir::DenseElementsAttr::get(type, double(i)));
+  builder.create<ReturnOp>(loc, value);
+}
+
+/// Return the best time in seconds to verify `module` over the runs, or a
+/// negative value if it fails to verify.
+static double timeVerify(mlir::ModuleOp module) {
+  bool invalid = false;
+  double best =
+      timeBest([&] { invalid |= mlir::failed(mlir::verify(module)); });
+  return invalid ? -1 : best;
+}
+
+/// Benchmark the verification of modules of every size built by `build`, and
+/// return false if it isn't linear or fails.
+static bool runBenchmark(mlir::MLIRContext &context, llvm::StringRef name,
+                         BuildFn build) {
+  llvm::outs() << "workload: " << name << "\n";
+  llvm::outs() << "  " << llvm::right_justify("operations", 12) << " "
+               << llvm::right_justify("verify ms", 12) << " "
+               << llvm::right_justify("ns/op", 12) << "\n";
+  double firstTimePerOp = 0, lastTimePerOp = 0;
+  for (unsigned size = 0; size < numSizes; ++size) {
+    mlir::OpBuilder builder(&context);
+    mlir::OwningOpRef<mlir::ModuleOp> module =
+        mlir::ModuleOp::create(builder.getUnknownLoc());
+    builder.setInsertionPointToEnd(module->getBody());
+    build(builder, size_t(numOps) << size);
+
+    size_t count = 0;
+    module->walk([&](mlir::Operation *) { ++count; });
+    double seconds = timeVerify(*module);
+    if (seconds < 0) {
+      llvm::errs() << name << ": module verification error\n";
+      return false;
+    }
+    lastTimePerOp = seconds / count * 1e9;
+    if (size == 0)
+      firstTimePerOp = lastTimePerOp;
+    llvm::outs() << llvm::format("  %12zu %12.2f %12.1f\n", count,
+                                 seconds * 1e3, lastTimePerOp);
+  }
+
+  double growth = firstTimePerOp ? lastTimePerOp / firstTimePerOp : 0;
+  bool linear = growth <= maxGrowth;
+  llvm::outs() << llvm::format("  growth of the time per operation: %.2fx",
+                               growth)
+               << (linear ? "\n" : " (not linear)\n");
+  return linear;
+}
+
+int main(int argc, char **argv) {
+  mlir::registerMLIRContextCLOptions();
+  cl::ParseCommandLineOptions(argc, argv, "toy verification benchmark\n");
+  if (repetitions == 0 || numSizes == 0) {
+    llvm::errs() << "-repeat and -sizes must be at least 1\n";
+    return 1;
+  }
+
+  mlir::MLIRContext context;
+  context.getOrLoadDialect<ToyDialect>();
+
+  bool success = true;
+  success &= runBenchmark(context, "functions", buildFunctions);
+  success &= runBenchmark(context, "long-function", buildLongFunction);
+  success &= runBenchmark(context, "constants", buildConstants);
+  return success ? 0 : 1;
+}
@@ -6,9 +6,10 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// This file implements the AST for the Toy language. It is optimized for
-// simplicity, not efficiency. The AST forms a tree structure where each node
-// references its children using std::unique_ptr<>.
+// This file implements the AST for the Toy language. The AST forms a tree
+// structure where each node references its children with plain pointers. All
+// the nodes, names and child lists of a module live in an arena owned by the
+// ModuleAST and are freed at once with it.
 //
 //===----------------------------------------------------------------------===//
 
@@ -18,17 +19,64 @@
 #include "toy/Lexer.h"
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <type_traits>
 #include <utility>
 #include <vector>
-#include <optional>
 
 namespace toy {
 
+/// The storage for the nodes of an AST. Nodes, names and child lists are bump
+/// allocated and never destroyed individually: the whole arena is released at
+/// once, so everything allocated in it must be trivially destructible.
+class ASTArena {
+public:
+  /// Allocate a new node of type T constructed with the given arguments.
+  template <typename T, typename... Args>
+  T *create(Args &&...args) {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "AST nodes are never destroyed");
+    return new (allocator.Allocate<T>()) T(std::forward<Args>(args)...);
+  }
+
+  /// Copy a list of values into the arena.
+  template <typename T>
+  llvm::MutableArrayRef<T> copy(llvm::ArrayRef<T> values) {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "AST nodes are never destroyed");
+    if (values.empty())
+      return {};
+    T *data = allocator.Allocate<T>(values.size());
+    std::uninitialized_copy(values.begin(), values.end(), data);
+    return {data, values.size()};
+  }
+
+  /// Copy a string into the arena.
+  llvm::StringRef copy(llvm::StringRef str) {
+    llvm::ArrayRef<char> chars = copy(llvm::ArrayRef(str.data(), str.size()));
+    return {chars.data(), chars.size()};
+  }
+
+  /// Return the number of bytes allocated so far.
+  size_t getBytesAllocated() const { return allocator.getBytesAllocated(); }
+
+private:
+  llvm::BumpPtrAllocator allocator;
+};
+
 /// A variable type with shape information.
 struct VarType {
-  std::vector<int64_t> shape;
+  llvm::ArrayRef<int64_t> shape;
 };
 
 /// Base class for all expression nodes.
@@ -43,11 +91,12 @@ public:
     Expr_BinOp,
     Expr_Call,
     Expr_Print,
+    Expr_Load,
+    Expr_Save,
   };
 
   ExprAST(ExprASTKind kind, Location location)
-      : kind(kind), location(std::move(location)) {}
-  virtual ~ExprAST() = default;
+      : kind(kind), location(location) {}
 
   ExprASTKind getKind() const { return kind; }
 
@@ -59,15 +108,14 @@ private:
 };
 
 /// A block-list of expressions.
-using ExprASTList = std::vector<std::unique_ptr<ExprAST>>;
+using ExprASTList = llvm::MutableArrayRef<ExprAST *>;
 
 /// Expression class for numeric literals like "1.0".
 class NumberExprAST : public ExprAST {
   double val;
 
 public:
-  NumberExprAST(Location loc, double val)
-      : ExprAST(Expr_Num, std::move(loc)), val(val) {}
+  NumberExprAST(Location loc, double val) : ExprAST(Expr_Num, loc), val(val) {}
 
   double getValue() { return val; }
 
@@ -75,31 +123,51 @@ public:
   static bool classof(const ExprAST *c) { return c->getKind() == Expr_Num; }
 };
 
-/// Expression class for a literal value.
+/// Expression class for a literal value. The values are stored flattened in
+/// row-major order, along with the dimensions of the literal. A splat literal,
+/// whose elements all have the same value, only stores it once.
 class LiteralExprAST : public ExprAST {
-  std::vector<std::unique_ptr<ExprAST>> values;
-  std::vector<int64_t> dims;
+  llvm::ArrayRef<double> data;
+  llvm::ArrayRef<int64_t> dims;
 
 public:
-  LiteralExprAST(Location loc, std::vector<std::unique_ptr<ExprAST>> values,
-                 std::vector<int64_t> dims)
-      : ExprAST(Expr_Literal, std::move(loc)), values(std::move(values)),
-        dims(std::move(dims)) {}
+  LiteralExprAST(Location loc, llvm::ArrayRef<double> data,
+                 llvm::ArrayRef<int64_t> dims)
+      : ExprAST(Expr_Literal, loc), data(data), dims(dims) {
+    assert((data.size() == 1 || data.size() == getNumElements()) &&
+           "expected a value per element or a splat value");
+  }
 
-  llvm::ArrayRef<std::unique_ptr<ExprAST>> getValues() { return values; }
+  /// Return the stored values: one per element, or the single value of a
+  /// splat literal.
+  llvm::ArrayRef<double> getData() { return data; }
   llvm::ArrayRef<int64_t> getDims() { return dims; }
 
+  /// Return whether all the elements have the value `getData()[0]`.
+  bool isSplat() { return data.size() == 1; }
+
+  /// Return the number of elements of the literal.
+  size_t getNumElements() {
+    size_t numElements = 1;
+    for (int64_t dim : dims)
+      numElements *= dim;
+    return numElements;
+  }
+
+  /// Return the value of the element at `index` in row-major order.
+  double getValue(size_t index) { return data[isSplat() ? 0 : index]; }
+
   /// LLVM style RTTI
   static bool classof(const ExprAST *c) { return c->getKind() == Expr_Literal; }
 };
 
 /// Expression class for referencing a variable, like "a".
 class VariableExprAST : public ExprAST {
-  std::string name;
+  llvm::StringRef name;
 
 public:
   VariableExprAST(Location loc, llvm::StringRef name)
-      : ExprAST(Expr_Var, std::move(loc)), name(name) {}
+      : ExprAST(Expr_Var, loc), name(name) {}
 
   llvm::StringRef getName() { return name; }
 
@@ -109,19 +177,21 @@ public:
 
 /// Expression class for defining a variable.
 class VarDeclExprAST : public ExprAST {
-  std::string name;
+  llvm::StringRef name;
   VarType type;
-  std::unique_ptr<ExprAST> initVal;
+  ExprAST *initVal;
 
 public:
   VarDeclExprAST(Location loc, llvm::StringRef name, VarType type,
-                 std::unique_ptr<ExprAST> initVal)
-      : ExprAST(Expr_VarDecl, std::move(loc)), name(name),
-        type(std::move(type)), initVal(std::move(initVal)) {}
+                 ExprAST *initVal)
+      : ExprAST(Expr_VarDecl, loc), name(name), type(type), initVal(initVal) {}
 
   llvm::StringRef getName() { return name; }
-  ExprAST *getInitVal() { return initVal.get(); }
+  ExprAST *getInitVal() { return initVal; }
   const VarType &getType() { return type; }
+  llvm::MutableArrayRef<ExprAST *> getOperands() {
+    return llvm::MutableArrayRef(&initVal, initVal ? 1 : 0);
+  }
 
   /// LLVM style RTTI
   static bool classof(const ExprAST *c) { return c->getKind() == Expr_VarDecl; }
@@ -129,17 +199,20 @@ public:
 
 /// Expression class for a return operator.
 class ReturnExprAST : public ExprAST {
-  std::optional<std::unique_ptr<ExprAST>> expr;
+  ExprAST *expr;
 
 public:
-  ReturnExprAST(Location loc, std::optional<std::unique_ptr<ExprAST>> expr)
-      : ExprAST(Expr_Return, std::move(loc)), expr(std::move(expr)) {}
+  ReturnExprAST(Location loc, ExprAST *expr)
+      : ExprAST(Expr_Return, loc), expr(expr) {}
 
   std::optional<ExprAST *> getExpr() {
-    if (expr.has_value())
-      return expr->get();
+    if (expr)
+      return expr;
     return std::nullopt;
   }
+  llvm::MutableArrayRef<ExprAST *> getOperands() {
+    return llvm::MutableArrayRef(&expr, expr ? 1 : 0);
+  }
 
   /// LLVM style RTTI
   static bool classof(const ExprAST *c) { return c->getKind() == Expr_Return; }
@@ -148,17 +221,16 @@ public:
 /// Expression class for a binary operator.
 class BinaryExprAST : public ExprAST {
   char op;
-  std::unique_ptr<ExprAST> lhs, rhs;
+  ExprAST *operands[2];
 
 public:
   char getOp() { return op; }
-  ExprAST *getLHS() { return lhs.get(); }
-  ExprAST *getRHS() { return rhs.get(); }
+  ExprAST *getLHS() { return operands[0]; }
+  ExprAST *getRHS() { return operands[1]; }
+  llvm::MutableArrayRef<ExprAST *> getOperands() { return operands; }
 
-  BinaryExprAST(Location loc, char op, std::unique_ptr<ExprAST> lhs,
-                std::unique_ptr<ExprAST> rhs)
-      : ExprAST(Expr_BinOp, std::move(loc)), op(op), lhs(std::move(lhs)),
-        rhs(std::move(rhs)) {}
+  BinaryExprAST(Location loc, char op, ExprAST *lhs, ExprAST *rhs)
+      : ExprAST(Expr_BinOp, loc), op(op), operands{lhs, rhs} {}
 
   /// LLVM style RTTI
   static bool classof(const ExprAST *c) { return c->getKind() == Expr_BinOp; }
@@ -166,17 +238,17 @@ public:
 
 /// Expression class for function calls.
 class CallExprAST : public ExprAST {
-  std::string callee;
-  std::vector<std::unique_ptr<ExprAST>> args;
+  llvm::StringRef callee;
+  llvm::MutableArrayRef<ExprAST *> args;
 
 public:
-  CallExprAST(Location loc, const std::string &callee,
-              std::vector<std::unique_ptr<ExprAST>> args)
-      : ExprAST(Expr_Call, std::move(loc)), callee(callee),
-        args(std::move(args)) {}
+  CallExprAST(Location loc, llvm::StringRef callee,
+              llvm::MutableArrayRef<ExprAST *> args)
+      : ExprAST(Expr_Call, loc), callee(callee), args(args) {}
 
   llvm::StringRef getCallee() { return callee; }
-  llvm::ArrayRef<std::unique_ptr<ExprAST>> getArgs() { return args; }
+  llvm::ArrayRef<ExprAST *> getArgs() { return args; }
+  llvm::MutableArrayRef<ExprAST *> getOperands() { return args; }
 
   /// LLVM style RTTI
   static bool classof(const ExprAST *c) { return c->getKind() == Expr_Call; }
@@ -184,62 +256,273 @@ public:
 
 /// Expression class for builtin print calls.
 class PrintExprAST : public ExprAST {
-  std::unique_ptr<ExprAST> arg;
+  ExprAST *arg;
 
 public:
-  PrintExprAST(Location loc, std::unique_ptr<ExprAST> arg)
-      : ExprAST(Expr_Print, std::move(loc)), arg(std::move(arg)) {}
+  PrintExprAST(Location loc, ExprAST *arg)
+      : ExprAST(Expr_Print, loc), arg(arg) {}
 
-  ExprAST *getArg() { return arg.get(); }
+  ExprAST *getArg() { return arg; }
+  llvm::MutableArrayRef<ExprAST *> getOperands() { return arg; }
 
   /// LLVM style RTTI
   static bool classof(const ExprAST *c) { return c->getKind() == Expr_Print; }
 };
 
+/// Expression class for builtin load calls, reading a tensor from a file.
+class LoadExprAST : public ExprAST {
+  llvm::StringRef path;
+
+public:
+  LoadExprAST(Location loc, llvm::StringRef path)
+      : ExprAST(Expr_Load, loc), path(path) {}
+
+  llvm::StringRef getPath() { return path; }
+
+  /// LLVM style RTTI
+  static bool classof(const ExprAST *c) { return c->getKind() == Expr_Load; }
+};
+
+/// Expression class for builtin save calls, writing a tensor to a file.
+class SaveExprAST : public ExprAST {
+  ExprAST *arg;
+  llvm::StringRef path;
+
+public:
+  SaveExprAST(Location loc, ExprAST *arg, llvm::StringRef path)
+      : ExprAST(Expr_Save, loc), arg(arg), path(path) {}
+
+  ExprAST *getArg() { return arg; }
+  llvm::StringRef getPath() { return path; }
+  llvm::MutableArrayRef<ExprAST *> getOperands() { return arg; }
+
+  /// LLVM style RTTI
+  static bool classof(const ExprAST *c) { return c->getKind() == Expr_Save; }
+};
+
 /// This class represents the "prototype" for a function, which captures its
 /// name, and its argument names (thus implicitly the number of arguments the
 /// function takes).
 class PrototypeAST {
   Location location;
-  std::string name;
-  std::vector<std::unique_ptr<VariableExprAST>> args;
+  llvm::StringRef name;
+  llvm::ArrayRef<VariableExprAST *> args;
 
 public:
-  PrototypeAST(Location location, const std::string &name,
-               std::vector<std::unique_ptr<VariableExprAST>> args)
-      : location(std::move(location)), name(name), args(std::move(args)) {}
+  PrototypeAST(Location location, llvm::StringRef name,
+               llvm::ArrayRef<VariableExprAST *> args)
+      : location(location), name(name), args(args) {}
 
   const Location &loc() { return location; }
   llvm::StringRef getName() const { return name; }
-  llvm::ArrayRef<std::unique_ptr<VariableExprAST>> getArgs() { return args; }
+  llvm::ArrayRef<VariableExprAST *> getArgs() { return args; }
 };
 
 /// This class represents a function definition itself.
 class FunctionAST {
-  std::unique_ptr<PrototypeAST> proto;
-  std::unique_ptr<ExprASTList> body;
+  PrototypeAST *proto;
+  ExprASTList *body;
 
 public:
-  FunctionAST(std::unique_ptr<PrototypeAST> proto,
-              std::unique_ptr<ExprASTList> body)
-      : proto(std::move(proto)), body(std::move(body)) {}
-  PrototypeAST *getProto() { return proto.get(); }
-  ExprASTList *getBody() { return body.get(); }
+  FunctionAST(PrototypeAST *proto, ExprASTList *body)
+      : proto(proto), body(body) {}
+  PrototypeAST *getProto() { return proto; }
+  ExprASTList *getBody() { return body; }
 };
 
-/// This class represents a list of functions to be processed together
+/// This class represents a list of functions to be processed together. It owns
+/// the arenas holding all the nodes of the module, and keeps the source file
+/// all the locations in the module refer to.
 class ModuleAST {
-  std::vector<FunctionAST> functions;
+  std::vector<std::unique_ptr<ASTArena>> arenas;
+  llvm::MutableArrayRef<FunctionAST> functions;
+  std::shared_ptr<SourceFile> file;
 
 public:
-  ModuleAST(std::vector<FunctionAST> functions)
-      : functions(std::move(functions)) {}
+  ModuleAST(std::unique_ptr<ASTArena> arena,
+            llvm::MutableArrayRef<FunctionAST> functions,
+            std::shared_ptr<SourceFile> file)
+      : functions(functions), file(std::move(file)) {
+    arenas.push_back(std::move(arena));
+  }
+
+  /// Create a module with the functions of all `modules` in order, taking
+  /// ownership of their arenas. The modules must refer to the same file.
+  explicit ModuleAST(llvm::MutableArrayRef<std::unique_ptr<ModuleAST>> modules)
+      : file(modules.front()->file) {
+    auto arena = std::make_unique<ASTArena>();
+    std::vector<FunctionAST> allFunctions;
+    for (auto &module : modules) {
+      assert(module->file == file && "merging modules from different files");
+      allFunctions.insert(allFunctions.end(), module->functions.begin(),
+                          module->functions.end());
+      for (auto &moduleArena : module->arenas)
+        arenas.push_back(std::move(moduleArena));
+    }
+    functions = arena->copy(llvm::ArrayRef(allFunctions));
+    arenas.push_back(std::move(arena));
+  }
 
   auto begin() { return functions.begin(); }
   auto end() { return functions.end(); }
+
+  /// Return the source file the locations in this module refer to.
+  const SourceFile &getSourceFile() { return *file; }
+
+  /// Return the arena in which to allocate the nodes added to this module.
+  ASTArena &getArena() { return *arenas.back(); }
+
+  /// Return the number of bytes allocated for the nodes of this module.
+  size_t getBytesAllocated() const {
+    size_t bytes = 0;
+    for (const auto &arena : arenas)
+      bytes += arena->getBytesAllocated();
+    return bytes;
+  }
 };
 
-void dump(ModuleAST &);
+/// A visitor of expressions, dispatching statically on their kind to the
+/// `visit` method of `Derived` for their class, without any virtual call. The
+/// methods `Derived` doesn't define fall back to `visitExpr`, which returns a
+/// default constructed value unless `Derived` defines it as well. For example:
+///
+///   struct CallCounter : ASTVisitor<CallCounter, unsigned> {
+///     unsigned visitCallExpr(CallExprAST *call) { return 1; }
+///   };
+///
+/// Only the visited expression is dispatched: walking its operands, returned by
+/// `getOperands`, is left to `Derived`.
+template <typename Derived, typename RetTy = void>
+class ASTVisitor {
+public:
+  RetTy visit(ExprAST *expr) {
+    switch (expr->getKind()) {
+    case ExprAST::Expr_VarDecl:
+      return derived().visitVarDeclExpr(llvm::cast<VarDeclExprAST>(expr));
+    case ExprAST::Expr_Return:
+      return derived().visitReturnExpr(llvm::cast<ReturnExprAST>(expr));
+    case ExprAST::Expr_Num:
+      return derived().visitNumberExpr(llvm::cast<NumberExprAST>(expr));
+    case ExprAST::Expr_Literal:
+      return derived().visitLiteralExpr(llvm::cast<LiteralExprAST>(expr));
+    case ExprAST::Expr_Var:
+      return derived().visitVariableExpr(llvm::cast<VariableExprAST>(expr));
+    case ExprAST::Expr_BinOp:
+      return derived().visitBinaryExpr(llvm::cast<BinaryExprAST>(expr));
+    case ExprAST::Expr_Call:
+      return derived().visitCallExpr(llvm::cast<CallExprAST>(expr));
+    case ExprAST::Expr_Print:
+      return derived().visitPrintExpr(llvm::cast<PrintExprAST>(expr));
+    case ExprAST::Expr_Load:
+      return derived().visitLoadExpr(llvm::cast<LoadExprAST>(expr));
+    case ExprAST::Expr_Save:
+      return derived().visitSaveExpr(llvm::cast<SaveExprAST>(expr));
+    }
+    return derived().visitExpr(expr);
+  }
+
+  RetTy visitVarDeclExpr(VarDeclExprAST *expr) {
+    return derived().visitExpr(expr);
+  }
+  RetTy visitReturnExpr(ReturnExprAST *expr) {
+    return derived().visitExpr(expr);
+  }
+  RetTy visitNumberExpr(NumberExprAST *expr) {
+    return derived().visitExpr(expr);
+  }
+  RetTy visitLiteralExpr(LiteralExprAST *expr) {
+    return derived().visitExpr(expr);
+  }
+  RetTy visitVariableExpr(VariableExprAST *expr) {
+    return derived().visitExpr(expr);
+  }
+  RetTy visitBinaryExpr(BinaryExprAST *expr) {
+    return derived().visitExpr(expr);
+  }
+  RetTy visitCallExpr(CallExprAST *expr) { return derived().visitExpr(expr); }
+  RetTy visitPrintExpr(PrintExprAST *expr) {
+    return derived().visitExpr(expr);
+  }
+  RetTy visitLoadExpr(LoadExprAST *expr) { return derived().visitExpr(expr); }
+  RetTy visitSaveExpr(SaveExprAST *expr) { return derived().visitExpr(expr); }
+  RetTy visitExpr(ExprAST *) { return RetTy(); }
+
+private:
+  Derived &derived() { return static_cast<Derived &>(*this); }
+};
+
+/// Return the operands of `expr`, the expressions it is computed from, in
+/// order. They may be replaced in place.
+inline llvm::MutableArrayRef<ExprAST *> getOperands(ExprAST *expr) {
+  struct OperandGetter
+      : ASTVisitor<OperandGetter, llvm::MutableArrayRef<ExprAST *>> {
+    auto visitVarDeclExpr(VarDeclExprAST *expr) { return expr->getOperands(); }
+    auto visitReturnExpr(ReturnExprAST *expr) { return expr->getOperands(); }
+    auto visitBinaryExpr(BinaryExprAST *expr) { return expr->getOperands(); }
+    auto visitCallExpr(CallExprAST *expr) { return expr->getOperands(); }
+    auto visitPrintExpr(PrintExprAST *expr) { return expr->getOperands(); }
+    auto visitSaveExpr(SaveExprAST *expr) { return expr->getOperands(); }
+  };
+  return OperandGetter().visit(expr);
+}
+
+/// A visitor rewriting expressions bottom up. Each `visit` method of `Derived`
+/// returns the expression replacing the visited one in its parent, which is
+/// the visited one itself by default. The operands of an expression are
+/// rewritten before it, so that it is visited with their replacements. New
+/// expressions are to be allocated in an arena of the module being rewritten.
+///
+/// The trees are walked with an explicit stack rather than by recursion, as
+/// generated code can nest expressions deeper than the native stack allows.
+template <typename Derived>
+class ASTRewriter : public ASTVisitor<Derived, ExprAST *> {
+public:
+  /// Rewrite the tree rooted at `root` and return its replacement.
+  ExprAST *rewrite(ExprAST *root) {
+    ExprAST *result = root;
+    // The slots holding the expressions to rewrite, with whether their
+    // operands were scheduled.
+    llvm::SmallVector<std::pair<ExprAST **, bool>, 16> worklist = {
+        {&result, false}};
+    while (!worklist.empty()) {
+      auto &[slot, operandsScheduled] = worklist.back();
+      if (!operandsScheduled) {
+        operandsScheduled = true;
+        llvm::MutableArrayRef<ExprAST *> operands = getOperands(*slot);
+        for (ExprAST *&operand : llvm::reverse(operands))
+          worklist.push_back({&operand, false});
+        continue;
+      }
+      ExprAST **current = worklist.pop_back_val().first;
+      *current = this->visit(*current);
+      assert(*current && "expressions can't be rewritten to null");
+    }
+    return result;
+  }
+
+  /// Rewrite every expression of `block`.
+  void rewrite(ExprASTList &block) {
+    for (ExprAST *&expr : block)
+      expr = rewrite(expr);
+  }
+
+  /// Rewrite every expression of `module`.
+  void rewrite(ModuleAST &module) {
+    for (FunctionAST &function : module)
+      rewrite(*function.getBody());
+  }
+
+  ExprAST *visitExpr(ExprAST *expr) { return expr; }
+};
+
+/// Print the AST of `module` to `os`. Literals with more than `literalLimit`
+/// values are summarized by their first values.
+void dump(ModuleAST &module, llvm::raw_ostream &os = llvm::errs(),
+          std::optional<size_t> literalLimit = std::nullopt);
+
+/// Replace the additions and multiplications of two numbers in `module` by
+/// their result, at the location of the operator.
+void foldConstants(ModuleAST &module);
 
 } // namespace toy
 
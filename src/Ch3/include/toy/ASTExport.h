@@ -0,0 +1,71 @@
+//===- ASTExport.h - Machine-readable outputs of the Toy AST --------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the export of a Toy AST in formats meant for tools rather
+// than people: JSON, and a compact binary format.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TOY_ASTEXPORT_H
+#define TOY_ASTEXPORT_H
+
+#include "toy/AST.h"
+
+#include "llvm/Support/raw_ostream.h"
+#include <cstddef>
+#include <optional>
+
+namespace toy {
+
+/// Write the AST of `module` to `os` as a single JSON object:
+///
+///   {"file": "example.toy", "functions": [
+///     {"name": "main", "line": 1, "col": 1, "params": ["a"], "body": [
+///       {"kind": "Return", "line": 2, "col": 3, "operands": [
+///         {"kind": "BinOp", "line": 2, "col": 12, "op": "+", "operands": [
+///           {"kind": "Var", "line": 2, "col": 10, "name": "a"},
+///           {"kind": "Num", "line": 2, "col": 14, "value": 1}]}]}]}]}
+///
+/// Every expression has a "kind" named after its ExprASTKind and a location,
+/// followed by the fields of its class and its "operands" when it has any.
+/// The fields are "name" and "shape" for VarDecl, "value" for Num, "dims",
+/// "count" and "values" for Literal, "name" for Var, "op" for BinOp, "callee"
+/// for Call and "path" for Load and Save. The "values" of a literal with more
+/// than `literalLimit` of them are truncated, "count" being their number.
+void exportJSON(ModuleAST &module, llvm::raw_ostream &os,
+                std::optional<size_t> literalLimit = std::nullopt);
+
+/// Write the AST of `module` to `os` in a compact binary format. Integers are
+/// unsigned LEB128, and floating point values are 64-bit IEEE in little
+/// endian. A string is written in full the first time it is used, as the
+/// number of distinct strings seen before it followed by its size and its
+/// bytes; later uses only write its index in the order of first use. The
+/// module is written as:
+///
+///   "TOYAST", format version (1 byte), file name (string),
+///   number of functions, then for each function:
+///     name (string), line, column, number of parameters, parameters
+///     (strings), number of statements, statements (expressions)
+///
+/// and each expression as its ExprASTKind (1 byte), line, column, the fields
+/// of its class, then its number of operands and the operands:
+///
+///   VarDecl: name (string), rank, dimensions
+///   Num: value (double)
+///   Literal: rank, dimensions, number of values, number of values written
+///            (at most `literalLimit`), values (doubles)
+///   Var: name (string)
+///   BinOp: operator (1 byte)
+///   Call: callee (string)
+///   Load, Save: path (string)
+void exportBinary(ModuleAST &module, llvm::raw_ostream &os,
+                  std::optional<size_t> literalLimit = std::nullopt);
+
+} // namespace toy
+
+#endif // TOY_ASTEXPORT_H
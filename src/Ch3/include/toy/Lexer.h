@@ -13,20 +13,23 @@
 #ifndef TOY_LEXER_H
 #define TOY_LEXER_H
 
+#include "toy/LexerScan.h"
+#include "toy/Location.h"
+
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <charconv>
 #include <memory>
 #include <string>
 
 namespace toy {
 
-/// Structure definition a location in a file.
-struct Location {
-  std::shared_ptr<std::string> file; ///< filename.
-  int line;                          ///< line number.
-  int col;                           ///< column number.
-};
-
 // List of Token returned by the lexer.
 enum Token : int {
   tok_semicolon = ';',
@@ -47,6 +50,10 @@ enum Token : int {
   // primary
   tok_identifier = -5,
   tok_number = -6,
+  tok_string = -7,
+
+  // malformed input, already reported by the lexer
+  tok_error = -8,
 };
 
 /// The Lexer is an abstract base class providing all the facilities that the
@@ -55,13 +62,15 @@ enum Token : int {
 /// It relies on a subclass to provide a `readNextLine()` method. The subclass
 /// can proceed by reading the next line from the standard input or from a
 /// memory mapped file.
+/// Alternatively, a subclass holding the whole input in memory can hand it to
+/// the protected constructor below: the lexer then scans that buffer in place
+/// with a cursor and never calls `readNextLine()`.
 class Lexer {
 public:
   /// Create a lexer for the given filename. The filename is kept only for
   /// debugging purpose (attaching a location to a Token).
   Lexer(std::string filename)
-      : lastLocation(
-            {std::make_shared<std::string>(std::move(filename)), 0, 0}) {}
+      : file(std::make_shared<SourceFile>(std::move(filename))) {}
   virtual ~Lexer() = default;
 
   /// Look at the current token in the stream.
@@ -80,7 +89,14 @@ public:
   /// Return the current identifier (prereq: getCurToken() == tok_identifier)
   llvm::StringRef getId() {
     assert(curTok == tok_identifier);
-    return identifierStr;
+    return identifier;
+  }
+
+  /// Return the spelling of the current number as it appears in the input
+  /// (prereq: getCurToken() == tok_number)
+  llvm::StringRef getNumberSpelling() {
+    assert(curTok == tok_number);
+    return numberSpelling;
   }
 
   /// Return the current number (prereq: getCurToken() == tok_number)
@@ -89,14 +105,64 @@ public:
     return numVal;
   }
 
+  /// Return the content of the current string literal, without the quotes
+  /// (prereq: getCurToken() == tok_string)
+  llvm::StringRef getString() {
+    assert(curTok == tok_string);
+    return string;
+  }
+
   /// Return the location for the beginning of the current token.
   Location getLastLocation() { return lastLocation; }
 
+  /// Return the line and column numbers of the current token, as reported in
+  /// diagnostics. Like the original line-based lexer, the end of file is
+  /// reported at the column of the last character of the input, or at column 0
+  /// of the line following a final newline.
+  LineColumn getLastLineColumn() {
+    LineColumn lineCol = file->getLineColumn(lastLocation);
+    if (curTok == tok_eof)
+      --lineCol.col;
+    return lineCol;
+  }
+
+  /// Return the file the locations returned by the lexer refer to.
+  const std::shared_ptr<SourceFile> &getSourceFile() { return file; }
+
+  /// Return the stream errors are reported to, `llvm::errs()` by default. The
+  /// parser reports its errors to the same stream.
+  llvm::raw_ostream &getDiagnosticStream() { return *diagOS; }
+
+  /// Report errors to `os` instead of `llvm::errs()`.
+  void setDiagnosticStream(llvm::raw_ostream &os) { diagOS = &os; }
+
   // Return the current line in the file.
-  int getLine() { return curLineNum; }
+  int64_t getLine() {
+    if (isScanningInPlace())
+      return getCurLineColumn().line;
+    return curLineNum;
+  }
 
   // Return the current column in the file.
-  int getCol() { return curCol; }
+  int64_t getCol() {
+    if (isScanningInPlace())
+      return getCurLineColumn().col;
+    return curCol;
+  }
+
+protected:
+  /// Create a lexer scanning the bytes [begin, end) of the content of `file`
+  /// in place. Identifiers and numbers are returned as slices of that content,
+  /// and locations are offsets from the start of the file. Runs of whitespace,
+  /// comments and digits are skipped with the given `kernels`.
+  Lexer(std::shared_ptr<SourceFile> file, const ScanKernels &kernels,
+        size_t begin = 0, size_t end = llvm::StringRef::npos)
+      : file(std::move(file)), kernels(&kernels) {
+    llvm::StringRef buffer = this->file->getContents();
+    bufferStart = buffer.begin();
+    curPtr = bufferStart + begin;
+    bufferEnd = bufferStart + std::min(end, buffer.size());
+  }
 
 private:
   /// Delegate to a derived class fetching the next line. Returns an empty
@@ -112,6 +178,7 @@ private:
     if (curLineBuffer.empty())
       return EOF;
     ++curCol;
+    ++curOffset;
     auto nextchar = curLineBuffer.front();
     curLineBuffer = curLineBuffer.drop_front();
     if (curLineBuffer.empty())
@@ -123,15 +190,101 @@ private:
     return nextchar;
   }
 
+  /// Return true if the lexer scans an in-memory buffer with a cursor instead
+  /// of pulling lines from `readNextLine()`.
+  bool isScanningInPlace() const { return bufferEnd != nullptr; }
+
+  /// Compute the value of the number spelled as `spelling` and return
+  /// tok_number, or report an error and return tok_error if the whole spelling
+  /// isn't a valid number. The conversion is locale independent and correctly
+  /// rounded, and reads the spelling in place. Like `strtod`, numbers too small
+  /// to be represented round to 0, but numbers too large are errors.
+  Token lexNumber(llvm::StringRef spelling) {
+    numberSpelling = spelling;
+    auto [ptr, ec] = std::from_chars(spelling.begin(), spelling.end(), numVal);
+    if ((ec != std::errc() && ec != std::errc::result_out_of_range) ||
+        ptr != spelling.end())
+      return lexError("malformed number", spelling);
+    if (ec == std::errc::result_out_of_range) {
+      // The value is left unset, tell an underflow from an overflow.
+      llvm::APFloat value(llvm::APFloat::IEEEdouble());
+      llvm::Expected<llvm::APFloat::opStatus> status =
+          value.convertFromString(spelling, llvm::APFloat::rmNearestTiesToEven);
+      if (!status) {
+        llvm::consumeError(status.takeError());
+        return lexError("malformed number", spelling);
+      }
+      if (*status & llvm::APFloat::opOverflow)
+        return lexError("number out of range", spelling);
+      numVal = value.convertToDouble();
+    }
+    return tok_number;
+  }
+
+  /// Report an error about the current token and return tok_error.
+  Token lexError(llvm::StringRef message, llvm::StringRef spelling) {
+    LineColumn lineCol = file->getLineColumn(lastLocation);
+    *diagOS << "Lex error (" << lineCol.line << ", " << lineCol.col
+            << "): " << message << " '" << spelling << "'\n";
+    return tok_error;
+  }
+
+  /// Return the location of the cursor when scanning in place.
+  Location getCurLocation() {
+    return {static_cast<uint64_t>(curPtr - bufferStart)};
+  }
+
+  /// Return the line and column numbers of the cursor when scanning in place,
+  /// as `getNextChar()` counts them: the character at the cursor has already
+  /// been read unless it is the end of the input, and a newline moves to
+  /// column 0 of the next line.
+  LineColumn getCurLineColumn() {
+    Location loc = getCurLocation();
+    if (curPtr != bufferEnd && *curPtr != '\0')
+      ++loc.offset;
+    LineColumn lineCol = file->getLineColumn(loc);
+    --lineCol.col;
+    return lineCol;
+  }
+
+  /// Return true if `c` can continue a number: a number glued to letters or
+  /// digits, like `1.2.3`, `1e` or `2x`, is lexed as a single malformed token.
+  static bool isNumberSuffixChar(int c) {
+    return llvm::isAlnum(c) || c == '_' || c == '.';
+  }
+
+  /// Return the keyword token spelled as `identifier`, or tok_identifier.
+  static Token getKeyword(llvm::StringRef identifier) {
+    switch (identifier.size()) {
+    case 3:
+      if (identifier == "def")
+        return tok_def;
+      if (identifier == "var")
+        return tok_var;
+      break;
+    case 6:
+      if (identifier == "return")
+        return tok_return;
+      break;
+    }
+    return tok_identifier;
+  }
+
   ///  Return the next token from standard input.
   Token getTok() {
+    if (isScanningInPlace())
+      return getTokInPlace();
+
     // Skip any whitespace.
     while (isspace(lastChar))
       lastChar = Token(getNextChar());
 
-    // Save the current location before reading the token characters.
-    lastLocation.line = curLineNum;
-    lastLocation.col = curCol;
+    // Save the current location before reading the token characters. At the
+    // end of file, this is the offset right after the last character. Only the
+    // lines where tokens or comments start are recorded in the file, to decode
+    // their locations.
+    lastLocation.offset = curOffset + (lastChar == EOF);
+    file->addLineStart(curLineNum, curOffset + 1 - curCol);
 
     // Identifier: [a-zA-Z][a-zA-Z0-9_]*
     if (isalpha(lastChar)) {
@@ -139,25 +292,44 @@ private:
       while (isalnum((lastChar = Token(getNextChar()))) || lastChar == '_')
         identifierStr += (char)lastChar;
 
-      if (identifierStr == "return")
-        return tok_return;
-      if (identifierStr == "def")
-        return tok_def;
-      if (identifierStr == "var")
-        return tok_var;
-      return tok_identifier;
+      identifier = identifierStr;
+      return getKeyword(identifier);
     }
 
-    // Number: [0-9.]+
+    // Number: [0-9.]+ ([eE] [+-]? [0-9]+)?
     if (isdigit(lastChar) || lastChar == '.') {
-      std::string numStr;
+      numberStr.clear();
       do {
-        numStr += lastChar;
+        numberStr += lastChar;
         lastChar = Token(getNextChar());
       } while (isdigit(lastChar) || lastChar == '.');
 
-      numVal = strtod(numStr.c_str(), nullptr);
-      return tok_number;
+      if (lastChar == 'e' || lastChar == 'E') {
+        numberStr += lastChar;
+        lastChar = Token(getNextChar());
+        if (lastChar == '+' || lastChar == '-') {
+          numberStr += lastChar;
+          lastChar = Token(getNextChar());
+        }
+      }
+      while (isNumberSuffixChar(lastChar)) {
+        numberStr += lastChar;
+        lastChar = Token(getNextChar());
+      }
+      return lexNumber(numberStr);
+    }
+
+    // String: '"' [^"\n]* '"'
+    if (lastChar == '"') {
+      stringStr.clear();
+      while ((lastChar = Token(getNextChar())) != '"') {
+        if (lastChar == EOF || lastChar == '\n' || lastChar == '\r')
+          return lexError("unterminated string", "\"" + stringStr);
+        stringStr += lastChar;
+      }
+      lastChar = Token(getNextChar());
+      string = stringStr;
+      return tok_string;
     }
 
     if (lastChar == '#') {
@@ -168,6 +340,9 @@ private:
 
       if (lastChar != EOF)
         return getTok();
+      // Like the original lexer, the end of file is reported at the '#' of a
+      // comment running to the end of the input (see getLastLineColumn()).
+      ++lastLocation.offset;
     }
 
     // Check for end of file.  Don't eat the EOF.
@@ -180,14 +355,100 @@ private:
     return thisChar;
   }
 
+  /// Return the next token from the in-memory buffer. This follows the same
+  /// grammar as `getTok()` but moves a cursor over the buffer instead of
+  /// pulling characters one at a time.
+  Token getTokInPlace() {
+    while (true) {
+      // Skip any whitespace.
+      curPtr = kernels->skipWhitespace(curPtr, bufferEnd);
+
+      // Check for end of file. A null character terminates the input as well.
+      if (curPtr == bufferEnd || *curPtr == '\0') {
+        lastLocation = getCurLocation();
+        return tok_eof;
+      }
+
+      // Comment until end of line.
+      if (*curPtr != '#')
+        break;
+      const char *commentStart = curPtr;
+      curPtr = kernels->skipToLineEnd(curPtr, bufferEnd);
+
+      // The end of file is reported at the '#' of a comment running to the end
+      // of the input, like `getTok()` does.
+      if (curPtr == bufferEnd || *curPtr == '\0') {
+        lastLocation = {static_cast<uint64_t>(commentStart + 1 - bufferStart)};
+        return tok_eof;
+      }
+    }
+
+    // Save the current location before reading the token characters.
+    const char *tokStart = curPtr;
+    lastLocation = getCurLocation();
+    char thisChar = *curPtr++;
+
+    // Identifier: [a-zA-Z][a-zA-Z0-9_]*
+    if (llvm::isAlpha(thisChar)) {
+      while (curPtr != bufferEnd && (llvm::isAlnum(*curPtr) || *curPtr == '_'))
+        ++curPtr;
+      identifier = llvm::StringRef(tokStart, curPtr - tokStart);
+      return getKeyword(identifier);
+    }
+
+    // Number: [0-9.]+ ([eE] [+-]? [0-9]+)?
+    if (llvm::isDigit(thisChar) || thisChar == '.') {
+      curPtr = kernels->skipNumber(curPtr, bufferEnd);
+      if (curPtr != bufferEnd && (*curPtr == 'e' || *curPtr == 'E')) {
+        ++curPtr;
+        if (curPtr != bufferEnd && (*curPtr == '+' || *curPtr == '-'))
+          ++curPtr;
+      }
+      while (curPtr != bufferEnd && isNumberSuffixChar(*curPtr))
+        ++curPtr;
+      return lexNumber(llvm::StringRef(tokStart, curPtr - tokStart));
+    }
+
+    // String: '"' [^"\n]* '"'
+    if (thisChar == '"') {
+      const char *stringEnd = std::find_if(curPtr, bufferEnd, [](char c) {
+        return c == '"' || c == '\n' || c == '\r' || c == '\0';
+      });
+      if (stringEnd == bufferEnd || *stringEnd != '"') {
+        curPtr = stringEnd;
+        return lexError("unterminated string",
+                        llvm::StringRef(tokStart, curPtr - tokStart));
+      }
+      string = llvm::StringRef(curPtr, stringEnd - curPtr);
+      curPtr = stringEnd + 1;
+      return tok_string;
+    }
+
+    // Otherwise, just return the character as its ascii value.
+    return Token(thisChar);
+  }
+
   /// The last token read from the input.
   Token curTok = tok_eof;
 
   /// Location for `curTok`.
   Location lastLocation;
 
-  /// If the current Token is an identifier, this string contains the value.
-  std::string identifierStr;
+  /// If the current Token is an identifier, this contains the value. It points
+  /// either into the scanned buffer or into `identifierStr`.
+  llvm::StringRef identifier;
+
+  /// If the current Token is a number, this contains its spelling. It points
+  /// either into the scanned buffer or into `numberStr`.
+  llvm::StringRef numberSpelling;
+
+  /// If the current Token is a string literal, this contains its content. It
+  /// points either into the scanned buffer or into `stringStr`.
+  llvm::StringRef string;
+
+  /// Storage for identifiers, numbers and strings when reading line by line, as
+  /// the line buffers are not guaranteed to outlive the token.
+  std::string identifierStr, numberStr, stringStr;
 
   /// If the current Token is a number, this contains the value.
   double numVal = 0;
@@ -198,13 +459,33 @@ private:
   Token lastChar = Token(' ');
 
   /// Keep track of the current line number in the input stream
-  int curLineNum = 0;
+  int64_t curLineNum = 0;
 
   /// Keep track of the current column number in the input stream
-  int curCol = 0;
+  int64_t curCol = 0;
+
+  /// Offset in the input stream of the last character returned by
+  /// `getNextChar()`. The stream starts with a virtual newline at offset -1
+  /// (see `curLineBuffer`), so nothing has been returned yet.
+  int64_t curOffset = -2;
+
+  /// The file being lexed, used to decode locations.
+  std::shared_ptr<SourceFile> file;
+
+  /// The stream errors are reported to.
+  llvm::raw_ostream *diagOS = &llvm::errs();
 
   /// Buffer supplied by the derived class on calls to `readNextLine()`
   llvm::StringRef curLineBuffer = "\n";
+
+  /// When scanning in place: the start and the end of the buffer, and the
+  /// cursor.
+  const char *bufferStart = nullptr;
+  const char *bufferEnd = nullptr;
+  const char *curPtr = nullptr;
+
+  /// When scanning in place: the kernels used to skip over runs of characters.
+  const ScanKernels *kernels = nullptr;
 };
 
 /// A lexer implementation operating on a buffer in memory.
@@ -227,6 +508,84 @@ private:
   }
   const char *current, *end;
 };
+
+/// A lexer implementation reading its input incrementally from a file, such as
+/// a pipe or a socket. The input is read in chunks into a fixed-size buffer
+/// that is reused once the lexer has consumed it, and lexing starts as soon as
+/// the first bytes are available instead of waiting for the whole input. The
+/// only memory growing with the input is the start of the lines holding
+/// tokens or comments, recorded to decode locations, which a client done with
+/// the locations before a token can release with
+/// `SourceFile::releaseLinesBefore`.
+class LexerFileDescriptor final : public Lexer {
+public:
+  /// Read from `fd`, which is not closed by the lexer. The filename is kept
+  /// only for debugging purpose.
+  LexerFileDescriptor(llvm::sys::fs::file_t fd, std::string filename,
+                      size_t bufferSize = 64 * 1024)
+      : Lexer(std::move(filename)), fd(fd),
+        buffer(std::make_unique<char[]>(bufferSize)), bufferSize(bufferSize) {}
+
+private:
+  /// Provide the input to the Lexer as it is read: each chunk is what a single
+  /// read returned, so lines may be split across chunks. Return an empty string
+  /// at the end of the file, on a read error, or when reaching a null character
+  /// like LexerBuffer does.
+  llvm::StringRef readNextLine() override {
+    if (done)
+      return {};
+    llvm::Expected<size_t> bytesRead = llvm::sys::fs::readNativeFile(
+        fd, llvm::MutableArrayRef<char>(buffer.get(), bufferSize));
+    if (!bytesRead) {
+      getDiagnosticStream() << "Could not read input: "
+                            << llvm::toString(bytesRead.takeError()) << "\n";
+      done = true;
+      return {};
+    }
+    llvm::StringRef chunk(buffer.get(), *bytesRead);
+    size_t nullChar = chunk.find('\0');
+    if (nullChar != llvm::StringRef::npos)
+      chunk = chunk.take_front(nullChar);
+    done = chunk.size() != *bytesRead || chunk.empty();
+    return chunk;
+  }
+
+  llvm::sys::fs::file_t fd;
+  std::unique_ptr<char[]> buffer;
+  size_t bufferSize;
+
+  /// Set once the end of the input has been reached.
+  bool done = false;
+};
+
+/// A lexer implementation scanning a whole buffer in memory in place, such as
+/// the content of an `llvm::MemoryBuffer`. Identifiers and numbers are returned
+/// as slices of the buffer.
+class LexerMemoryBuffer final : public Lexer {
+public:
+  /// Scan the content of `file`, which is kept alive by the lexer and by the
+  /// AST built from it.
+  LexerMemoryBuffer(std::shared_ptr<SourceFile> file,
+                    const ScanKernels &kernels = getScanKernels())
+      : Lexer(std::move(file), kernels) {}
+
+  /// Scan only the bytes [begin, end) of the content of `file`. Locations are
+  /// still offsets from the start of the file.
+  LexerMemoryBuffer(std::shared_ptr<SourceFile> file, size_t begin, size_t end,
+                    const ScanKernels &kernels = getScanKernels())
+      : Lexer(std::move(file), kernels, begin, end) {}
+
+  /// Scan `buffer`, which must outlive the lexer and the AST built from it.
+  LexerMemoryBuffer(llvm::StringRef buffer, std::string filename,
+                    const ScanKernels &kernels = getScanKernels())
+      : Lexer(std::make_shared<SourceFile>(llvm::MemoryBuffer::getMemBuffer(
+                  buffer, filename, /*RequiresNullTerminator=*/false)),
+              kernels) {}
+
+private:
+  /// The base class scans the buffer directly and never asks for lines.
+  llvm::StringRef readNextLine() override { return {}; }
+};
 } // namespace toy
 
 #endif // TOY_LEXER_H
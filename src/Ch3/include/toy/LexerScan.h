@@ -0,0 +1,54 @@
+//===- LexerScan.h - Vectorized scanning kernels for the Toy lexer --------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the kernels the Lexer uses to skip over runs of
+// whitespace, comments and digits when scanning a buffer in place. Several
+// implementations are available (scalar, SSE2, AVX2) and the best one supported
+// by the host is selected at runtime.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TOY_LEXERSCAN_H
+#define TOY_LEXERSCAN_H
+
+namespace toy {
+
+/// The instruction sets the scanning kernels are implemented for.
+enum class ScanISA { Scalar, SSE2, AVX2 };
+
+/// A set of scanning kernels. Each kernel takes the range [cur, end) and
+/// returns a pointer to the first character that does not belong to the run
+/// being skipped, or `end`.
+struct ScanKernels {
+  /// Skip whitespace characters.
+  const char *(*skipWhitespace)(const char *cur, const char *end);
+
+  /// Skip to the end of the current line, i.e. the next '\n' or '\r', or to a
+  /// null character, which ends the input.
+  const char *(*skipToLineEnd)(const char *cur, const char *end);
+
+  /// Skip the characters of a number: [0-9.]
+  const char *(*skipNumber)(const char *cur, const char *end);
+
+  /// The instruction set these kernels are implemented with.
+  ScanISA isa;
+};
+
+/// Return the kernels for the best instruction set supported by the host.
+const ScanKernels &getScanKernels();
+
+/// Return the kernels for the given instruction set, or nullptr if they are
+/// not available in this build or not supported by the host.
+const ScanKernels *getScanKernels(ScanISA isa);
+
+/// Return a printable name for the given instruction set.
+const char *getScanISAName(ScanISA isa);
+
+} // namespace toy
+
+#endif // TOY_LEXERSCAN_H
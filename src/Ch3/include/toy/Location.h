@@ -0,0 +1,115 @@
+//===- Location.h - Source locations for the Toy language -----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the compact source locations attached to tokens and AST
+// nodes, and the source file they are decoded against.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TOY_LOCATION_H
+#define TOY_LOCATION_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace toy {
+
+/// A location in a source file, stored as the offset of a character from the
+/// start of the file. A Toy module always comes from a single file, so the
+/// file itself is recorded once by the lexer and the ModuleAST, and line and
+/// column numbers are only computed when a location is printed. Offsets are 64
+/// bits wide so that generated files larger than 4 GiB can be compiled.
+struct Location {
+  uint64_t offset = 0; ///< offset in the file.
+};
+
+/// Line and column numbers of a location, both starting at 1, or both 0 when
+/// the location can't be decoded.
+struct LineColumn {
+  int64_t line;
+  int64_t col;
+};
+
+/// A source file the locations of an AST refer to. It maps offsets to line and
+/// column numbers using the offsets of the start of the lines. These are either
+/// computed for every line from the content of the file on first use, or
+/// recorded by the lexer as it reads a file that isn't kept in memory, only for
+/// the lines holding tokens or comments.
+class SourceFile {
+public:
+  /// Create a source file whose content is held in memory by `buffer`.
+  SourceFile(std::unique_ptr<llvm::MemoryBuffer> buffer)
+      : name(buffer->getBufferIdentifier()), buffer(std::move(buffer)) {}
+
+  /// Create a source file whose content isn't kept in memory. The start of the
+  /// lines holding the locations to decode must be reported with
+  /// `addLineStart()` while reading it.
+  SourceFile(std::string name)
+      : name(std::move(name)), lineStarts({0}), lineNumbers({1}) {}
+
+  /// Return the name of the file.
+  llvm::StringRef getName() const { return name; }
+
+  /// Return the content of the file, or an empty buffer if it isn't kept in
+  /// memory.
+  llvm::StringRef getContents() const {
+    return buffer ? buffer->getBuffer() : llvm::StringRef();
+  }
+
+  /// Record that line number `line` starts at `offset`, for a file that isn't
+  /// kept in memory. Lines must be recorded in order, but the lines holding no
+  /// location to decode can be skipped.
+  void addLineStart(int64_t line, uint64_t offset) {
+    assert(!buffer && "line starts are computed from the buffer");
+    if (lineNumbers.back() == line)
+      return;
+    lineStarts.push_back(offset);
+    lineNumbers.push_back(line);
+  }
+
+  /// Forget the lines recorded before the one holding `loc`, so that the
+  /// memory used to decode the locations of a file that isn't kept in memory
+  /// doesn't grow with the whole file. The locations before it are decoded as
+  /// line 0 from then on. This takes time proportional to the number of lines
+  /// released, and does nothing for a file kept in memory or for a location
+  /// that was already released.
+  void releaseLinesBefore(Location loc);
+
+  /// Return the line and column numbers of `loc`. This is thread-safe once the
+  /// file has been fully read.
+  LineColumn getLineColumn(Location loc) const;
+
+private:
+  std::string name;
+  std::unique_ptr<llvm::MemoryBuffer> buffer;
+
+  /// Offsets of the first character of every line, computed from `buffer` by
+  /// the first call to `getLineColumn()` when it is available.
+  mutable std::vector<uint64_t> lineStarts;
+  mutable std::once_flag lineStartsComputed;
+
+  /// When there is no `buffer`, the numbers of the lines starting at
+  /// `lineStarts`, which only hold the lines that were recorded.
+  std::vector<int64_t> lineNumbers;
+
+  /// Index in `lineStarts` and `lineNumbers` of the first line that wasn't
+  /// released. The released lines are erased once they are the majority, so
+  /// that the lines kept aren't moved on every release.
+  size_t firstLine = 0;
+};
+
+} // namespace toy
+
+#endif // TOY_LOCATION_H
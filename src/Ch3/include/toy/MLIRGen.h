@@ -14,6 +14,9 @@
 #ifndef TOY_MLIRGEN_H
 #define TOY_MLIRGEN_H
 
+#include "mlir/Support/LogicalResult.h"
+
+#include <cstdint>
 #include <memory>
 
 namespace mlir {
@@ -26,10 +29,48 @@ class ModuleOp;
 namespace toy {
 class ModuleAST;
 
+/// The granularity of the locations attached to the emitted operations. Finer
+/// locations help debugging, but every distinct one is uniqued and kept alive
+/// by the MLIRContext. Diagnostics of the IR generation itself always point
+/// to the file, line and column of the faulty code.
+enum class LocationGranularity {
+  /// The file, line and column of the code of every operation.
+  Full,
+  /// The location of the enclosing function for every operation.
+  Function,
+  /// Unknown locations everywhere.
+  None,
+};
+
+/// Options controlling the IR generation.
+struct MLIRGenOptions {
+  LocationGranularity locations = LocationGranularity::Full;
+
+  /// The size in bytes of the data above which literals are held in resource
+  /// blobs rather than in attributes uniqued by the context.
+  uint64_t literalResourceThreshold = 1 << 20;
+
+  /// Verify the module once it is emitted. This may be skipped for trusted
+  /// inputs, or when the IR is verified later anyway.
+  bool verify = true;
+
+  /// Emit the functions in parallel on the threads of the context, unless its
+  /// multithreading is disabled. The functions and the diagnostics are in the
+  /// same order as with a serial emission.
+  bool parallel = false;
+};
+
 /// Emit IR for the given Toy moduleAST, returns a newly created MLIR module
 /// or nullptr on failure.
 mlir::OwningOpRef<mlir::ModuleOp> mlirGen(mlir::MLIRContext &context,
-                                          ModuleAST &moduleAST);
+                                          ModuleAST &moduleAST,
+                                          MLIRGenOptions options = {});
+
+/// Emit IR for the functions of the given Toy moduleAST at the end of `module`,
+/// and verify the resulting module. This allows a Toy source file to be emitted
+/// one function at a time.
+mlir::LogicalResult mlirGen(mlir::ModuleOp module, ModuleAST &moduleAST,
+                            MLIRGenOptions options = {});
 } // namespace toy
 
 #endif // TOY_MLIRGEN_H
@@ -0,0 +1,55 @@
+//===- Npy.h - NumPy array files for the Toy language ---------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares the support for the NumPy `.npy` format, used by the
+// builtins `load` and `save` to bring tensors into a Toy program without
+// spelling them out as literals, and out of it without printing them as text.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TOY_NPY_H
+#define TOY_NPY_H
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace toy {
+
+/// A tensor read from a `.npy` file. The values are not copied: they point into
+/// the file, which is mapped in memory for as long as the array holds it.
+struct NpyArray {
+  /// The dimensions of the tensor, empty for a scalar.
+  std::vector<int64_t> shape;
+
+  /// The values of the tensor in row-major order.
+  llvm::ArrayRef<double> data;
+
+  /// The mapped file holding the values.
+  std::unique_ptr<llvm::MemoryBuffer> buffer;
+};
+
+/// Map the `.npy` file at `path` in memory and decode its header. As the values
+/// are used in place, only arrays of 64-bit floats in the byte order of the
+/// host and in row-major order are supported.
+llvm::Expected<NpyArray> readNpyFile(llvm::StringRef path);
+
+/// Write the values of a tensor with the given shape, in row-major order, to
+/// the `.npy` file at `path`. The file is created with its final size and
+/// mapped in memory when possible, so the values are copied into it in one go.
+llvm::Error writeNpyFile(llvm::StringRef path, llvm::ArrayRef<int64_t> shape,
+                         llvm::ArrayRef<double> data);
+
+} // namespace toy
+
+#endif // TOY_NPY_H
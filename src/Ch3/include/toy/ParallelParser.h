@@ -0,0 +1,45 @@
+//===- ParallelParser.h - Parallel parsing of Toy modules -----------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares a frontend parsing the top-level definitions of a Toy
+// module concurrently. Definitions are independent at the syntax level: the
+// input is split at the `def` keywords found outside of any block, and each
+// chunk is parsed by its own Lexer and Parser.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TOY_PARALLELPARSER_H
+#define TOY_PARALLELPARSER_H
+
+#include "toy/AST.h"
+
+#include "llvm/ADT/StringRef.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace toy {
+
+/// Return the offsets in `buffer` of the `def` keywords starting a top-level
+/// definition, in increasing order. Comments are skipped, and the scan stops at
+/// the first null character like the lexer does.
+std::vector<size_t> findTopLevelDefinitions(llvm::StringRef buffer);
+
+/// Parse the content of `file` into a module, parsing chunks of consecutive
+/// definitions in parallel. The functions are in source order and errors are
+/// reported to `llvm::errs()` exactly as `Parser::parseModule()` reports them:
+/// a chunk ends at the `def` starting the next one rather than at an end of
+/// file, and the diagnostics of each chunk are buffered and printed in source
+/// order, up to the first chunk that fails to parse. Returns nullptr on error.
+std::unique_ptr<ModuleAST>
+parseModuleInParallel(std::shared_ptr<SourceFile> file);
+
+} // namespace toy
+
+#endif // TOY_PARALLELPARSER_H
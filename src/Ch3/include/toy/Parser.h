@@ -18,6 +18,7 @@
 #include "toy/Lexer.h"
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -28,275 +29,427 @@
 
 namespace toy {
 
-/// This is a simple recursive parser for the Toy language. It produces a well
-/// formed AST from a stream of Token supplied by the Lexer. No semantic checks
-/// or symbol resolution is performed. For example, variables are referenced by
-/// string and the code could reference an undeclared variable and the parsing
-/// succeeds.
+/// This is a simple recursive parser for the Toy language, except for
+/// expressions which are parsed iteratively. It produces a well formed AST from
+/// a stream of Token supplied by the Lexer. No semantic checks or symbol
+/// resolution is performed. For example, variables are referenced by string and
+/// the code could reference an undeclared variable and the parsing succeeds.
 class Parser {
 public:
   /// Create a Parser for the supplied lexer.
   Parser(Lexer &lexer) : lexer(lexer) {}
 
-  /// Parse a full Module. A module is a list of function definitions.
-  std::unique_ptr<ModuleAST> parseModule() {
+  /// Parse a full Module. A module is a list of function definitions. When
+  /// `end` is given, the module ends with the last definition followed by a
+  /// token starting at or after that offset rather than by the end of file.
+  /// This parses a part of a file ending at a `def` keyword with the same
+  /// diagnostics as the whole file.
+  std::unique_ptr<ModuleAST>
+  parseModule(std::optional<uint64_t> end = std::nullopt) {
+    arena = std::make_unique<ASTArena>();
     lexer.getNextToken(); // prime the lexer
 
     // Parse functions one at a time and accumulate in this vector.
     std::vector<FunctionAST> functions;
-    while (auto f = parseDefinition()) {
-      functions.push_back(std::move(*f));
-      if (lexer.getCurToken() == tok_eof)
+    while (true) {
+      auto *f = parseDefinition();
+      if (!f) {
+        // If we didn't reach EOF, there was an error during parsing
+        if (lexer.getCurToken() != tok_eof)
+          parseError<ModuleAST>("nothing", "at end of module");
+        return nullptr;
+      }
+      functions.push_back(*f);
+      if (lexer.getCurToken() == tok_eof ||
+          (end && lexer.getLastLocation().offset >= *end))
         break;
     }
-    // If we didn't reach EOF, there was an error during parsing
-    if (lexer.getCurToken() != tok_eof)
-      return parseError<ModuleAST>("nothing", "at end of module");
 
-    return std::make_unique<ModuleAST>(std::move(functions));
+    auto moduleFunctions = arena->copy(llvm::ArrayRef(functions));
+    return std::make_unique<ModuleAST>(std::move(arena), moduleFunctions,
+                                       lexer.getSourceFile());
+  }
+
+  /// Parse the next function definition into a module of its own, allocated in
+  /// its own arena. This allows a file to be processed one function at a time,
+  /// releasing each function before the next one is parsed. Returns an empty
+  /// module once the whole input has been read, and nullptr on error. This must
+  /// not be mixed with `parseModule()` on the same lexer.
+  std::unique_ptr<ModuleAST> parseNextFunction() {
+    arena = std::make_unique<ASTArena>();
+    if (!started) {
+      lexer.getNextToken(); // prime the lexer
+      started = true;
+    }
+
+    llvm::MutableArrayRef<FunctionAST> functions;
+    if (lexer.getCurToken() != tok_eof) {
+      auto *f = parseDefinition();
+      if (!f)
+        return nullptr;
+      functions = *f;
+    }
+    return std::make_unique<ModuleAST>(std::move(arena), functions,
+                                       lexer.getSourceFile());
   }
 
 private:
   Lexer &lexer;
 
+  /// Whether `parseNextFunction()` already primed the lexer.
+  bool started = false;
+
+  /// The arena the nodes of the module being parsed are allocated in.
+  std::unique_ptr<ASTArena> arena;
+
+  /// Scratch buffer the values of a tensor literal are parsed into before
+  /// being copied to the arena, reused across literals. It only holds the
+  /// first value as long as all the values are the same, so that splat
+  /// literals take constant memory.
+  std::vector<double> literalData;
+
   /// Parse a return statement.
   /// return :== return ; | return expr ;
-  std::unique_ptr<ReturnExprAST> parseReturn() {
+  ReturnExprAST *parseReturn() {
     auto loc = lexer.getLastLocation();
     lexer.consume(tok_return);
 
     // return takes an optional argument
-    std::optional<std::unique_ptr<ExprAST>> expr;
+    ExprAST *expr = nullptr;
     if (lexer.getCurToken() != ';') {
       expr = parseExpression();
       if (!expr)
         return nullptr;
     }
-    return std::make_unique<ReturnExprAST>(std::move(loc), std::move(expr));
+    return arena->create<ReturnExprAST>(loc, expr);
   }
 
   /// Parse a literal number.
   /// numberexpr ::= number
-  std::unique_ptr<ExprAST> parseNumberExpr() {
+  ExprAST *parseNumberExpr() {
     auto loc = lexer.getLastLocation();
-    auto result =
-        std::make_unique<NumberExprAST>(std::move(loc), lexer.getValue());
+    auto *result = arena->create<NumberExprAST>(loc, lexer.getValue());
     lexer.consume(tok_number);
-    return std::move(result);
+    return result;
+  }
+
+  /// Parse a call to the builtin load, once its name has been consumed.
+  /// loadexpr ::= load '(' string ')'
+  ExprAST *parseLoadExpr(Location loc) {
+    lexer.consume(Token('('));
+    if (lexer.getCurToken() != tok_string)
+      return parseError<ExprAST>("<string>", "as argument to load()");
+    llvm::StringRef path = arena->copy(lexer.getString());
+    lexer.consume(tok_string);
+
+    if (lexer.getCurToken() != ')')
+      return parseError<ExprAST>(")", "to close load()");
+    lexer.consume(Token(')'));
+    return arena->create<LoadExprAST>(loc, path);
+  }
+
+  /// Parse the path following the tensor in a call to the builtin save, up to
+  /// the closing parenthesis.
+  /// saveexpr ::= save '(' expression ',' string ')'
+  std::optional<llvm::StringRef> parseSavePath() {
+    if (lexer.getCurToken() != ',') {
+      parseError<ExprAST>(",", "after the tensor to save()");
+      return std::nullopt;
+    }
+    lexer.getNextToken(); // eat ,
+    if (lexer.getCurToken() != tok_string) {
+      parseError<ExprAST>("<string>", "as path to save()");
+      return std::nullopt;
+    }
+    llvm::StringRef path = arena->copy(lexer.getString());
+    lexer.consume(tok_string);
+
+    if (lexer.getCurToken() != ')') {
+      parseError<ExprAST>(")", "to close save()");
+      return std::nullopt;
+    }
+    lexer.consume(Token(')'));
+    return path;
   }
 
   /// Parse a literal array expression.
   /// tensorLiteral ::= [ literalList ] | number
   /// literalList ::= tensorLiteral | tensorLiteral, literalList
-  std::unique_ptr<ExprAST> parseTensorLiteralExpr() {
+  ///
+  /// The nested lists are parsed iteratively, straight into a flat buffer of
+  /// values in row-major order. The dimensions of the literal are recorded the
+  /// first time a list is closed at each nesting level, and every other list
+  /// at the same level must have the same size.
+  ExprAST *parseTensorLiteralExpr() {
     auto loc = lexer.getLastLocation();
     lexer.consume(Token('['));
 
-    // Hold the list of values at this nesting level.
-    std::vector<std::unique_ptr<ExprAST>> values;
-    // Hold the dimensions for all the nesting inside this level.
-    std::vector<int64_t> dims;
+    // Hold the number of elements parsed so far in each of the open lists.
+    llvm::SmallVector<int64_t, 4> counts = {0};
+    // Hold the dimensions of the literal, 0 until the first list of a level is
+    // closed. They are only known once the first number gives the rank.
+    llvm::SmallVector<int64_t, 4> dims;
+    literalData.clear();
+    size_t numValues = 0;
+    bool splat = true;
     do {
+      ++counts.back();
+
       // We can have either another nested array or a number literal.
       if (lexer.getCurToken() == '[') {
-        values.push_back(parseTensorLiteralExpr());
-        if (!values.back())
-          return nullptr; // parse error in the nested array.
-      } else {
-        if (lexer.getCurToken() != tok_number)
-          return parseError<ExprAST>("<num> or [", "in literal expression");
-        values.push_back(parseNumberExpr());
+        lexer.consume(Token('['));
+        counts.push_back(0);
+        continue;
       }
+      if (lexer.getCurToken() != tok_number)
+        return parseError<ExprAST>("<num> or [", "in literal expression");
 
-      // End of this list on ']'
-      if (lexer.getCurToken() == ']')
-        break;
-
-      // Elements are separated by a comma.
-      if (lexer.getCurToken() != ',')
-        return parseError<ExprAST>("] or ,", "in literal expression");
-
-      lexer.getNextToken(); // eat ,
-    } while (true);
-    if (values.empty())
-      return parseError<ExprAST>("<something>", "to fill literal expression");
-    lexer.getNextToken(); // eat ]
-
-    /// Fill in the dimensions now. First the current nesting level:
-    dims.push_back(values.size());
-
-    /// If there is any nested array, process all of them and ensure that
-    /// dimensions are uniform.
-    if (llvm::any_of(values, [](std::unique_ptr<ExprAST> &expr) {
-          return llvm::isa<LiteralExprAST>(expr.get());
-        })) {
-      auto *firstLiteral = llvm::dyn_cast<LiteralExprAST>(values.front().get());
-      if (!firstLiteral)
+      // All the numbers must be nested at the same depth.
+      if (dims.empty())
+        dims.resize(counts.size());
+      else if (dims.size() != counts.size())
         return parseError<ExprAST>("uniform well-nested dimensions",
                                    "inside literal expression");
-
-      // Append the nested dimensions to the current level
-      auto firstDims = firstLiteral->getDims();
-      dims.insert(dims.end(), firstDims.begin(), firstDims.end());
-
-      // Sanity check that shape is uniform across all elements of the list.
-      for (auto &expr : values) {
-        auto *exprLiteral = llvm::cast<LiteralExprAST>(expr.get());
-        if (!exprLiteral)
-          return parseError<ExprAST>("uniform well-nested dimensions",
-                                     "inside literal expression");
-        if (exprLiteral->getDims() != firstDims)
+      double value = lexer.getValue();
+      if (literalData.empty() || !splat) {
+        literalData.push_back(value);
+      } else if (value != literalData.front()) {
+        literalData.resize(numValues, literalData.front());
+        literalData.push_back(value);
+        splat = false;
+      }
+      ++numValues;
+      lexer.consume(tok_number);
+
+      // Close the lists ending here, checking that their size matches the
+      // other lists at the same nesting level.
+      while (lexer.getCurToken() == ']') {
+        int64_t &dim = dims[counts.size() - 1];
+        if (dim != 0 && dim != counts.back())
           return parseError<ExprAST>("uniform well-nested dimensions",
                                      "inside literal expression");
+        dim = counts.pop_back_val();
+        lexer.consume(Token(']'));
+        if (counts.empty()) {
+          return arena->create<LiteralExprAST>(
+              loc, arena->copy(llvm::ArrayRef(literalData)),
+              arena->copy(llvm::ArrayRef(dims)));
+        }
       }
-    }
-    return std::make_unique<LiteralExprAST>(std::move(loc), std::move(values),
-                                            std::move(dims));
-  }
-
-  /// parenexpr ::= '(' expression ')'
-  std::unique_ptr<ExprAST> parseParenExpr() {
-    lexer.getNextToken(); // eat (.
-    auto v = parseExpression();
-    if (!v)
-      return nullptr;
-
-    if (lexer.getCurToken() != ')')
-      return parseError<ExprAST>(")", "to close expression with parentheses");
-    lexer.consume(Token(')'));
-    return v;
-  }
-
-  /// identifierexpr
-  ///   ::= identifier
-  ///   ::= identifier '(' expression ')'
-  std::unique_ptr<ExprAST> parseIdentifierExpr() {
-    std::string name(lexer.getId());
-
-    auto loc = lexer.getLastLocation();
-    lexer.getNextToken(); // eat identifier.
-
-    if (lexer.getCurToken() != '(') // Simple variable ref.
-      return std::make_unique<VariableExprAST>(std::move(loc), name);
-
-    // This is a function call.
-    lexer.consume(Token('('));
-    std::vector<std::unique_ptr<ExprAST>> args;
-    if (lexer.getCurToken() != ')') {
-      while (true) {
-        if (auto arg = parseExpression())
-          args.push_back(std::move(arg));
-        else
-          return nullptr;
-
-        if (lexer.getCurToken() == ')')
-          break;
-
-        if (lexer.getCurToken() != ',')
-          return parseError<ExprAST>(", or )", "in argument list");
-        lexer.getNextToken();
-      }
-    }
-    lexer.consume(Token(')'));
-
-    // It can be a builtin call to print
-    if (name == "print") {
-      if (args.size() != 1)
-        return parseError<ExprAST>("<single arg>", "as argument to print()");
 
-      return std::make_unique<PrintExprAST>(std::move(loc), std::move(args[0]));
-    }
-
-    // Call to a user-defined function
-    return std::make_unique<CallExprAST>(std::move(loc), name, std::move(args));
+      // Elements are separated by a comma.
+      if (lexer.getCurToken() != ',')
+        return parseError<ExprAST>("] or ,", "in literal expression");
+      lexer.getNextToken(); // eat ,
+    } while (true);
   }
 
+  /// Parse an expression.
+  /// expression ::= primary (binop primary)*
   /// primary
-  ///   ::= identifierexpr
+  ///   ::= identifier
+  ///   ::= identifier '(' (expression (',' expression)*)? ')'
+  ///   ::= loadexpr
+  ///   ::= saveexpr
   ///   ::= numberexpr
-  ///   ::= parenexpr
-  ///   ::= tensorliteral
-  std::unique_ptr<ExprAST> parsePrimary() {
-    switch (lexer.getCurToken()) {
-    default:
-      llvm::errs() << "unknown token '" << lexer.getCurToken()
-                   << "' when expecting an expression\n";
-      return nullptr;
-    case tok_identifier:
-      return parseIdentifierExpr();
-    case tok_number:
-      return parseNumberExpr();
-    case '(':
-      return parseParenExpr();
-    case '[':
-      return parseTensorLiteralExpr();
-    case ';':
-      return nullptr;
-    case '}':
+  ///   ::= '(' expression ')'
+  ///   ::= tensorLiteral
+  ///
+  /// Expressions are parsed with explicit stacks of pending operators and
+  /// operands (shunting-yard) instead of recursing on every operator,
+  /// parenthesis and call, so that generated code with very long operator
+  /// chains or deep nesting parses in linear time without exhausting the
+  /// native stack. Binary operators are left associative and bind according to
+  /// `getTokPrecedence()`.
+  ExprAST *parseExpression() {
+    /// A binary operator waiting for its right operand to be complete.
+    struct PendingOperator {
+      int op;
+      int prec;
+      Location loc;
+    };
+    /// A parenthesized expression or a call being parsed. The operators and
+    /// operands pushed since it was opened belong to it: the arguments of a
+    /// call are the operands left once it is closed.
+    struct Group {
+      bool isCall;
+      /// Whether the group is the right operand of a binary operator.
+      bool afterOperator;
+      Location loc;
+      llvm::StringRef callee;
+      size_t operatorBase, operandBase;
+    };
+    llvm::SmallVector<ExprAST *, 8> operands;
+    llvm::SmallVector<PendingOperator, 8> operators;
+    llvm::SmallVector<Group, 4> groups;
+
+    // Combine the pending operators of the innermost group binding at least as
+    // tightly as `prec` with their operands.
+    auto reduce = [&](int prec) {
+      size_t base = groups.empty() ? 0 : groups.back().operatorBase;
+      while (operators.size() > base && operators.back().prec >= prec) {
+        PendingOperator binOp = operators.pop_back_val();
+        ExprAST *rhs = operands.pop_back_val();
+        operands.back() = arena->create<BinaryExprAST>(binOp.loc, binOp.op,
+                                                       operands.back(), rhs);
+      }
+    };
+
+    // Report a primary failing to parse, then every enclosing group failing in
+    // turn: an operand missing after a binary operator is diagnosed at each
+    // level, as a recursive parser would.
+    auto fail = [&](bool afterOperator) -> ExprAST * {
+      if (afterOperator)
+        parseError<ExprAST>("expression", "to complete binary operator");
+      for (const Group &group : llvm::reverse(groups))
+        if (group.afterOperator)
+          parseError<ExprAST>("expression", "to complete binary operator");
       return nullptr;
-    }
-  }
+    };
 
-  /// Recursively parse the right hand side of a binary expression, the ExprPrec
-  /// argument indicates the precedence of the current binary operator.
-  ///
-  /// binoprhs ::= ('+' primary)*
-  std::unique_ptr<ExprAST> parseBinOpRHS(int exprPrec,
-                                         std::unique_ptr<ExprAST> lhs) {
-    // If this is a binop, find its precedence.
+    bool expectOperand = true;
+    bool afterOperator = false;
     while (true) {
-      int tokPrec = getTokPrecedence();
+      if (expectOperand) {
+        switch (lexer.getCurToken()) {
+        default:
+          lexer.getDiagnosticStream()
+              << "unknown token '" << lexer.getCurToken()
+              << "' when expecting an expression\n";
+          return fail(afterOperator);
+        case tok_error: // Already reported by the lexer.
+        case ';':
+        case '}':
+          return fail(afterOperator);
+        case '(':
+          groups.push_back({/*isCall=*/false, afterOperator,
+                            lexer.getLastLocation(), {}, operators.size(),
+                            operands.size()});
+          lexer.consume(Token('('));
+          afterOperator = false;
+          continue;
+        case tok_identifier: {
+          llvm::StringRef name = arena->copy(lexer.getId());
+          auto loc = lexer.getLastLocation();
+          lexer.getNextToken(); // eat identifier.
+
+          if (lexer.getCurToken() != '(') { // Simple variable ref.
+            operands.push_back(arena->create<VariableExprAST>(loc, name));
+            break;
+          }
+
+          // It can be a builtin call to load, which takes a path instead of
+          // expressions.
+          if (name == "load") {
+            auto *load = parseLoadExpr(loc);
+            if (!load)
+              return fail(afterOperator);
+            operands.push_back(load);
+            break;
+          }
+
+          // This is a function call, its arguments are parsed as operands of
+          // the group. A call without arguments is closed right away below.
+          lexer.consume(Token('('));
+          groups.push_back({/*isCall=*/true, afterOperator, loc, name,
+                            operators.size(), operands.size()});
+          afterOperator = false;
+          if (lexer.getCurToken() != ')')
+            continue;
+          break;
+        }
+        case tok_number:
+          operands.push_back(parseNumberExpr());
+          break;
+        case '[': {
+          auto *literal = parseTensorLiteralExpr();
+          if (!literal)
+            return fail(afterOperator);
+          operands.push_back(literal);
+          break;
+        }
+        }
+        expectOperand = false;
+      }
 
-      // If this is a binop that binds at least as tightly as the current binop,
-      // consume it, otherwise we are done.
-      if (tokPrec < exprPrec)
-        return lhs;
-
-      // Okay, we know this is a binop.
-      int binOp = lexer.getCurToken();
-      lexer.consume(Token(binOp));
-      auto loc = lexer.getLastLocation();
-
-      // Parse the primary expression after the binary operator.
-      auto rhs = parsePrimary();
-      if (!rhs)
-        return parseError<ExprAST>("expression", "to complete binary operator");
-
-      // If BinOp binds less tightly with rhs than the operator after rhs, let
-      // the pending operator take rhs as its lhs.
-      int nextPrec = getTokPrecedence();
-      if (tokPrec < nextPrec) {
-        rhs = parseBinOpRHS(tokPrec + 1, std::move(rhs));
-        if (!rhs)
-          return nullptr;
+      // If this is a binop, combine the pending operators binding at least as
+      // tightly, and wait for its right operand.
+      int tokPrec = getTokPrecedence();
+      if (tokPrec >= 0) {
+        reduce(tokPrec);
+        int binOp = lexer.getCurToken();
+        lexer.consume(Token(binOp));
+        operators.push_back({binOp, tokPrec, lexer.getLastLocation()});
+        expectOperand = afterOperator = true;
+        continue;
       }
 
-      // Merge lhs/RHS.
-      lhs = std::make_unique<BinaryExprAST>(std::move(loc), binOp,
-                                            std::move(lhs), std::move(rhs));
+      // Otherwise the innermost group, or the whole expression, is complete.
+      reduce(0);
+      if (groups.empty())
+        return operands.pop_back_val();
+
+      Group &group = groups.back();
+      if (group.isCall && group.callee == "save") {
+        // It can be a builtin call to save, which takes the path of the file
+        // to write after the tensor.
+        std::optional<llvm::StringRef> path = parseSavePath();
+        Group closed = groups.pop_back_val();
+        if (!path)
+          return fail(closed.afterOperator);
+        operands.back() =
+            arena->create<SaveExprAST>(closed.loc, operands.back(), *path);
+        continue;
+      }
+      if (group.isCall && lexer.getCurToken() == ',') {
+        lexer.getNextToken(); // eat ,
+        expectOperand = true;
+        afterOperator = false;
+        continue;
+      }
+      if (lexer.getCurToken() != ')') {
+        if (group.isCall)
+          parseError<ExprAST>(", or )", "in argument list");
+        else
+          parseError<ExprAST>(")", "to close expression with parentheses");
+        return fail(groups.pop_back_val().afterOperator);
+      }
+      lexer.consume(Token(')'));
+      Group closed = groups.pop_back_val();
+      if (!closed.isCall)
+        continue;
+
+      llvm::ArrayRef<ExprAST *> args =
+          llvm::ArrayRef(operands).drop_front(closed.operandBase);
+      ExprAST *call;
+      if (closed.callee == "print") {
+        // It can be a builtin call to print
+        if (args.size() != 1) {
+          parseError<ExprAST>("<single arg>", "as argument to print()");
+          return fail(closed.afterOperator);
+        }
+        call = arena->create<PrintExprAST>(closed.loc, args[0]);
+      } else {
+        // Call to a user-defined function
+        call = arena->create<CallExprAST>(closed.loc, closed.callee,
+                                          arena->copy(args));
+      }
+      operands.truncate(closed.operandBase);
+      operands.push_back(call);
     }
   }
 
-  /// expression::= primary binop rhs
-  std::unique_ptr<ExprAST> parseExpression() {
-    auto lhs = parsePrimary();
-    if (!lhs)
-      return nullptr;
-
-    return parseBinOpRHS(0, std::move(lhs));
-  }
-
   /// type ::= < shape_list >
   /// shape_list ::= num | num , shape_list
-  std::unique_ptr<VarType> parseType() {
+  VarType *parseType() {
     if (lexer.getCurToken() != '<')
       return parseError<VarType>("<", "to begin type");
     lexer.getNextToken(); // eat <
 
-    auto type = std::make_unique<VarType>();
+    llvm::SmallVector<int64_t, 4> shape;
 
     while (lexer.getCurToken() == tok_number) {
-      type->shape.push_back(lexer.getValue());
+      shape.push_back(lexer.getValue());
       lexer.getNextToken();
       if (lexer.getCurToken() == ',')
         lexer.getNextToken();
@@ -305,14 +458,14 @@ private:
     if (lexer.getCurToken() != '>')
       return parseError<VarType>(">", "to end type");
     lexer.getNextToken(); // eat >
-    return type;
+    return arena->create<VarType>(VarType{arena->copy(llvm::ArrayRef(shape))});
   }
 
   /// Parse a variable declaration, it starts with a `var` keyword followed by
   /// and identifier and an optional type (shape specification) before the
   /// initializer.
   /// decl ::= var identifier [ type ] = expr
-  std::unique_ptr<VarDeclExprAST> parseDeclaration() {
+  VarDeclExprAST *parseDeclaration() {
     if (lexer.getCurToken() != tok_var)
       return parseError<VarDeclExprAST>("var", "to begin declaration");
     auto loc = lexer.getLastLocation();
@@ -321,22 +474,22 @@ private:
     if (lexer.getCurToken() != tok_identifier)
       return parseError<VarDeclExprAST>("identified",
                                         "after 'var' declaration");
-    std::string id(lexer.getId());
+    llvm::StringRef id = arena->copy(lexer.getId());
     lexer.getNextToken(); // eat id
 
-    std::unique_ptr<VarType> type; // Type is optional, it can be inferred
+    VarType type; // Type is optional, it can be inferred
     if (lexer.getCurToken() == '<') {
-      type = parseType();
-      if (!type)
+      auto *parsedType = parseType();
+      if (!parsedType)
         return nullptr;
+      type = *parsedType;
     }
 
-    if (!type)
-      type = std::make_unique<VarType>();
     lexer.consume(Token('='));
-    auto expr = parseExpression();
-    return std::make_unique<VarDeclExprAST>(std::move(loc), std::move(id),
-                                            std::move(*type), std::move(expr));
+    auto *expr = parseExpression();
+    if (!expr)
+      return nullptr;
+    return arena->create<VarDeclExprAST>(loc, id, type, expr);
   }
 
   /// Parse a block: a list of expression separated by semicolons and wrapped in
@@ -345,12 +498,12 @@ private:
   /// block ::= { expression_list }
   /// expression_list ::= block_expr ; expression_list
   /// block_expr ::= decl | "return" | expr
-  std::unique_ptr<ExprASTList> parseBlock() {
+  ExprASTList *parseBlock() {
     if (lexer.getCurToken() != '{')
       return parseError<ExprASTList>("{", "to begin block");
     lexer.consume(Token('{'));
 
-    auto exprList = std::make_unique<ExprASTList>();
+    llvm::SmallVector<ExprAST *, 16> exprList;
 
     // Ignore empty expressions: swallow sequences of semicolons.
     while (lexer.getCurToken() == ';')
@@ -359,22 +512,22 @@ private:
     while (lexer.getCurToken() != '}' && lexer.getCurToken() != tok_eof) {
       if (lexer.getCurToken() == tok_var) {
         // Variable declaration
-        auto varDecl = parseDeclaration();
+        auto *varDecl = parseDeclaration();
         if (!varDecl)
           return nullptr;
-        exprList->push_back(std::move(varDecl));
+        exprList.push_back(varDecl);
       } else if (lexer.getCurToken() == tok_return) {
         // Return statement
-        auto ret = parseReturn();
+        auto *ret = parseReturn();
         if (!ret)
           return nullptr;
-        exprList->push_back(std::move(ret));
+        exprList.push_back(ret);
       } else {
         // General expression
-        auto expr = parseExpression();
+        auto *expr = parseExpression();
         if (!expr)
           return nullptr;
-        exprList->push_back(std::move(expr));
+        exprList.push_back(expr);
       }
       // Ensure that elements are separated by a semicolon.
       if (lexer.getCurToken() != ';')
@@ -389,12 +542,12 @@ private:
       return parseError<ExprASTList>("}", "to close block");
 
     lexer.consume(Token('}'));
-    return exprList;
+    return arena->create<ExprASTList>(arena->copy(llvm::ArrayRef(exprList)));
   }
 
   /// prototype ::= def id '(' decl_list ')'
   /// decl_list ::= identifier | identifier, decl_list
-  std::unique_ptr<PrototypeAST> parsePrototype() {
+  PrototypeAST *parsePrototype() {
     auto loc = lexer.getLastLocation();
 
     if (lexer.getCurToken() != tok_def)
@@ -404,21 +557,20 @@ private:
     if (lexer.getCurToken() != tok_identifier)
       return parseError<PrototypeAST>("function name", "in prototype");
 
-    std::string fnName(lexer.getId());
+    llvm::StringRef fnName = arena->copy(lexer.getId());
     lexer.consume(tok_identifier);
 
     if (lexer.getCurToken() != '(')
       return parseError<PrototypeAST>("(", "in prototype");
     lexer.consume(Token('('));
 
-    std::vector<std::unique_ptr<VariableExprAST>> args;
+    llvm::SmallVector<VariableExprAST *, 4> args;
     if (lexer.getCurToken() != ')') {
       do {
-        std::string name(lexer.getId());
+        llvm::StringRef name = arena->copy(lexer.getId());
         auto loc = lexer.getLastLocation();
         lexer.consume(tok_identifier);
-        auto decl = std::make_unique<VariableExprAST>(std::move(loc), name);
-        args.push_back(std::move(decl));
+        args.push_back(arena->create<VariableExprAST>(loc, name));
         if (lexer.getCurToken() != ',')
           break;
         lexer.consume(Token(','));
@@ -432,21 +584,21 @@ private:
 
     // success.
     lexer.consume(Token(')'));
-    return std::make_unique<PrototypeAST>(std::move(loc), fnName,
-                                          std::move(args));
+    return arena->create<PrototypeAST>(loc, fnName,
+                                       arena->copy(llvm::ArrayRef(args)));
   }
 
   /// Parse a function definition, we expect a prototype initiated with the
   /// `def` keyword, followed by a block containing a list of expressions.
   ///
   /// definition ::= prototype block
-  std::unique_ptr<FunctionAST> parseDefinition() {
-    auto proto = parsePrototype();
+  FunctionAST *parseDefinition() {
+    auto *proto = parsePrototype();
     if (!proto)
       return nullptr;
 
-    if (auto block = parseBlock())
-      return std::make_unique<FunctionAST>(std::move(proto), std::move(block));
+    if (auto *block = parseBlock())
+      return arena->create<FunctionAST>(proto, block);
     return nullptr;
   }
 
@@ -472,14 +624,19 @@ private:
   /// indicating the expected token and another argument giving more context.
   /// Location is retrieved from the lexer to enrich the error message.
   template <typename R, typename T, typename U = const char *>
-  std::unique_ptr<R> parseError(T &&expected, U &&context = "") {
+  R *parseError(T &&expected, U &&context = "") {
     auto curToken = lexer.getCurToken();
-    llvm::errs() << "Parse error (" << lexer.getLastLocation().line << ", "
-                 << lexer.getLastLocation().col << "): expected '" << expected
-                 << "' " << context << " but has Token " << curToken;
+    // The lexer already reported why this token is invalid.
+    if (curToken == tok_error)
+      return nullptr;
+    LineColumn lineCol = lexer.getLastLineColumn();
+    llvm::raw_ostream &os = lexer.getDiagnosticStream();
+    os << "Parse error (" << lineCol.line << ", " << lineCol.col
+       << "): expected '" << expected << "' " << context << " but has Token "
+       << curToken;
     if (isprint(curToken))
-      llvm::errs() << " '" << (char)curToken << "'";
-    llvm::errs() << "\n";
+      os << " '" << (char)curToken << "'";
+    os << "\n";
     return nullptr;
   }
 };
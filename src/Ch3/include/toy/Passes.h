@@ -0,0 +1,28 @@
+//===- Passes.h - Toy Passes Definition -----------------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file exposes the entry points to create compiler passes for Toy.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef TOY_PASSES_H
+#define TOY_PASSES_H
+
+#include <memory>
+
+namespace mlir {
+class Pass;
+
+namespace toy {
+/// Create a pass inferring the static shapes of the results of the operations
+/// of a toy.func, from the constants and reshapes they are computed from.
+std::unique_ptr<Pass> createShapeInferencePass();
+} // namespace toy
+} // namespace mlir
+
+#endif // TOY_PASSES_H
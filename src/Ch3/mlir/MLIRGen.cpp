@@ -12,6 +12,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "toy/MLIRGen.h"
+#include "mlir/IR/AsmState.h"
 #include "mlir/IR/Block.h"
 #include "mlir/IR/Diagnostics.h"
 #include "mlir/IR/Value.h"
@@ -20,22 +21,30 @@
 #include "toy/Dialect.h"
 
 #include "mlir/IR/Builders.h"
+#include "mlir/IR/BuiltinAttributes.h"
 #include "mlir/IR/BuiltinOps.h"
 #include "mlir/IR/BuiltinTypes.h"
 #include "mlir/IR/MLIRContext.h"
+#include "mlir/IR/Threading.h"
 #include "mlir/IR/Verifier.h"
 #include "toy/Lexer.h"
+#include "toy/Npy.h"
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/ScopedHashTable.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
+#include "llvm/Support/Path.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
-#include <functional>
-#include <numeric>
+#include <limits>
 #include <optional>
+#include <string>
+#include <utility>
 #include <vector>
 
 using namespace mlir::toy;
@@ -57,29 +66,48 @@ namespace {
 /// This will emit operations that are specific to the Toy language, preserving
 /// the semantics of the language and (hopefully) allow to perform accurate
 /// analysis and transformation based on these high level semantics.
-class MLIRGenImpl {
+class MLIRGenImpl : public ASTVisitor<MLIRGenImpl, mlir::Value> {
 public:
-  MLIRGenImpl(mlir::MLIRContext &context) : builder(&context) {}
+  MLIRGenImpl(mlir::MLIRContext &context, MLIRGenOptions options)
+      : builder(&context), options(options),
+        functionLoc(builder.getUnknownLoc()) {}
 
   /// Public API: convert the AST for a Toy module (source file) to an MLIR
   /// Module operation.
   mlir::ModuleOp mlirGen(ModuleAST &moduleAST) {
     // We create an empty MLIR module and codegen functions one at a time and
     // add them to the module.
-    theModule = mlir::ModuleOp::create(builder.getUnknownLoc());
+    mlir::ModuleOp module = mlir::ModuleOp::create(builder.getUnknownLoc());
+    if (failed(mlirGen(module, moduleAST))) {
+      module.erase();
+      return nullptr;
+    }
+    return module;
+  }
 
-    for (FunctionAST &f : moduleAST)
-      mlirGen(f);
+  /// Public API: convert the AST for some functions of a Toy module to MLIR and
+  /// add them at the end of an existing Module operation.
+  mlir::LogicalResult mlirGen(mlir::ModuleOp module, ModuleAST &moduleAST) {
+    theModule = module;
+    setSourceFile(moduleAST.getSourceFile());
+
+    if (options.parallel) {
+      mlirGenInParallel(moduleAST);
+    } else {
+      for (FunctionAST &f : moduleAST)
+        if (mlir::toy::FuncOp function = mlirGen(f))
+          theModule.push_back(function);
+    }
 
     // Verify the module after we have finished constructing it, this will check
     // the structural properties of the IR and invoke any specific verifiers we
-    // have on the Toy operations.
-    if (failed(mlir::verify(theModule))) {
+    // have on the Toy operations. Functions are verified in parallel.
+    if (options.verify && failed(mlir::verify(theModule))) {
       theModule.emitError("module verification error");
-      return nullptr;
+      return mlir::failure();
     }
 
-    return theModule;
+    return mlir::success();
   }
 
 private:
@@ -97,10 +125,61 @@ private:
   /// scope is destroyed and the mappings created in this scope are dropped.
   llvm::ScopedHashTable<StringRef, mlir::Value> symbolTable;
 
-  /// Helper conversion for a Toy AST location to an MLIR location.
+  /// The values of the operands of the expressions being emitted, the last
+  /// operand on top.
+  SmallVector<mlir::Value, 16> operandValues;
+
+  MLIRGenOptions options;
+
+  /// The source file of the module being emitted, and its name as an
+  /// attribute so that it is only uniqued once.
+  const SourceFile *file = nullptr;
+  mlir::StringAttr filename;
+
+  /// Set the source file the locations of the AST refer to.
+  void setSourceFile(const SourceFile &sourceFile) {
+    file = &sourceFile;
+    filename = builder.getStringAttr(file->getName());
+  }
+
+  /// The locations created so far, keyed by their offset in the file. Looking
+  /// them up here is cheaper than computing their line and column and having
+  /// the context unique them again, and several operations often share one.
+  llvm::DenseMap<uint64_t, mlir::LocationAttr> fileLocs;
+
+  /// The location of the function being emitted, used for all its operations
+  /// with LocationGranularity::Function.
+  mlir::Location functionLoc;
+
+  /// Helper conversion for a Toy AST location to an MLIR location, at the
+  /// granularity selected by the options.
   mlir::Location loc(const Location &loc) {
-    return mlir::FileLineColLoc::get(builder.getStringAttr(*loc.file), loc.line,
-                                     loc.col);
+    switch (options.locations) {
+    case LocationGranularity::Full:
+      return fileLoc(loc);
+    case LocationGranularity::Function:
+      return functionLoc;
+    case LocationGranularity::None:
+      break;
+    }
+    return builder.getUnknownLoc();
+  }
+
+  /// Return the file, line and column of a Toy AST location, whatever the
+  /// granularity. This is what diagnostics point to. MLIR keeps line and
+  /// column numbers on 32 bits, so they saturate in huge files.
+  mlir::Location fileLoc(const Location &loc) {
+    mlir::LocationAttr &cached = fileLocs[loc.offset];
+    if (cached)
+      return cached;
+    LineColumn lineCol = file->getLineColumn(loc);
+    auto clamp = [](int64_t value) {
+      return static_cast<unsigned>(std::min<int64_t>(
+          value, std::numeric_limits<unsigned>::max()));
+    };
+    cached = mlir::FileLineColLoc::get(filename, clamp(lineCol.line),
+                                       clamp(lineCol.col));
+    return cached;
   }
 
   /// Declare a variable in the current scope, return success if the variable
@@ -115,6 +194,8 @@ private:
   /// Create the prototype for an MLIR function with as many arguments as the
   /// provided Toy AST prototype.
   mlir::toy::FuncOp mlirGen(PrototypeAST &proto) {
+    if (options.locations == LocationGranularity::Function)
+      functionLoc = fileLoc(proto.loc());
     auto location = loc(proto.loc());
 
     // This is a generic function, the return type will be inferred later.
@@ -126,13 +207,40 @@ private:
                                              funcType);
   }
 
-  /// Emit a new function and add it to the MLIR module.
+  /// Emit the functions of a module on the threads of the context. Function
+  /// bodies are independent, as calls refer to their callee by name: each one
+  /// is emitted by a generator of its own, with its own builder and symbol
+  /// table, and they are added to the module in source order once all are
+  /// done. Diagnostics are reported in source order as well.
+  void mlirGenInParallel(ModuleAST &moduleAST) {
+    std::vector<FunctionAST *> functionASTs;
+    for (FunctionAST &f : moduleAST)
+      functionASTs.push_back(&f);
+
+    mlir::MLIRContext *context = builder.getContext();
+    std::vector<mlir::toy::FuncOp> functions(functionASTs.size());
+    mlir::ParallelDiagnosticHandler diagHandler(context);
+    mlir::parallelFor(context, 0, functionASTs.size(), [&](size_t i) {
+      diagHandler.setOrderIDForThread(i);
+      MLIRGenImpl generator(*context, options);
+      generator.setSourceFile(*file);
+      functions[i] = generator.mlirGen(*functionASTs[i]);
+      diagHandler.eraseOrderIDForThread();
+    });
+
+    for (mlir::toy::FuncOp function : functions)
+      if (function)
+        theModule.push_back(function);
+  }
+
+  /// Emit a new function, detached from the module so that it can be emitted
+  /// on any thread. Return nullptr on failure.
   mlir::toy::FuncOp mlirGen(FunctionAST &funcAST) {
     // Create a scope in the symbol table to hold variable declarations.
     ScopedHashTableScope<llvm::StringRef, mlir::Value> varScope(symbolTable);
 
     // Create an MLIR function for the given prototype.
-    builder.setInsertionPointToEnd(theModule.getBody());
+    builder.clearInsertionPoint();
     mlir::toy::FuncOp function = mlirGen(*funcAST.getProto());
     if (!function)
       return nullptr;
@@ -145,8 +253,10 @@ private:
     for (const auto nameValue :
          llvm::zip(protoArgs, entryBlock.getArguments())) {
       if (failed(declare(std::get<0>(nameValue)->getName(),
-                         std::get<1>(nameValue))))
+                         std::get<1>(nameValue)))) {
+        function.erase();
         return nullptr;
+      }
     }
 
     // Set the insertion point in the builder to the beginning of the function
@@ -175,28 +285,23 @@ private:
           function.getFunctionType().getInputs(), getType(VarType{})));
     }
 
+    // Only `main` is called from outside the module: the other functions are
+    // private, so that they can be removed once their calls are inlined.
+    if (funcAST.getProto()->getName() != "main")
+      function.setPrivate();
+
     return function;
   }
 
-  /// Emit a binary operation
-  mlir::Value mlirGen(BinaryExprAST &binop) {
-    // First emit the operations for each side of the operation before emitting
-    // the operation itself. For example if the expression is `a + foo(a)`
-    // 1) First it will visiting the LHS, which will return a reference to the
-    //    value holding `a`. This value should have been emitted at declaration
-    //    time and registered in the symbol table, so nothing would be
-    //    codegen'd. If the value is not in the symbol table, an error has been
-    //    emitted and nullptr is returned.
-    // 2) Then the RHS is visited (recursively) and a call to `foo` is emitted
-    //    and the result value is returned. If an error occurs we get a nullptr
-    //    and propagate.
-    //
-    mlir::Value lhs = mlirGen(*binop.getLHS());
-    if (!lhs)
-      return nullptr;
-    mlir::Value rhs = mlirGen(*binop.getRHS());
-    if (!rhs)
-      return nullptr;
+  /// Emit a binary operation, once the operations for each side have been
+  /// emitted. For example if the expression is `a + foo(a)`
+  /// 1) First the LHS is visited, which returns a reference to the value
+  ///    holding `a`. This value should have been emitted at declaration time
+  ///    and registered in the symbol table, so nothing would be codegen'd.
+  /// 2) Then the RHS is visited, a call to `foo` is emitted and its result
+  ///    value is returned.
+  /// See the dispatch over expressions below for the traversal.
+  mlir::Value mlirGen(BinaryExprAST &binop, mlir::Value lhs, mlir::Value rhs) {
     auto location = loc(binop.loc());
 
     // Derive the operation name from the binary operator. At the moment we only
@@ -208,7 +313,8 @@ private:
       return builder.create<MulOp>(location, lhs, rhs);
     }
 
-    emitError(location, "invalid binary operator '") << binop.getOp() << "'";
+    emitError(fileLoc(binop.loc()), "invalid binary operator '")
+        << binop.getOp() << "'";
     return nullptr;
   }
 
@@ -219,7 +325,7 @@ private:
     if (auto variable = symbolTable.lookup(expr.getName()))
       return variable;
 
-    emitError(loc(expr.loc()), "error: unknown variable '")
+    emitError(fileLoc(expr.loc()), "error: unknown variable '")
         << expr.getName() << "'";
     return nullptr;
   }
@@ -262,68 +368,60 @@ private:
   mlir::Value mlirGen(LiteralExprAST &lit) {
     auto type = getType(lit.getDims());
 
-    // The attribute is a vector with a floating point value per element
-    // (number) in the array, see `collectData()` below for more details.
-    std::vector<double> data;
-    data.reserve(std::accumulate(lit.getDims().begin(), lit.getDims().end(), 1,
-                                 std::multiplies<int>()));
-    collectData(lit, data);
-
     // The type of this attribute is tensor of 64-bit floating-point with the
     // shape of the literal.
     mlir::Type elementType = builder.getF64Type();
     auto dataType = mlir::RankedTensorType::get(lit.getDims(), elementType);
 
     // This is the actual attribute that holds the list of values for this
-    // tensor literal.
-    auto dataAttribute =
-        mlir::DenseElementsAttr::get(dataType, llvm::ArrayRef(data));
+    // tensor literal. The parser already stores them as a flat vector with a
+    // floating point value per element (number) in the array, for example
+    // with this array:
+    //  [[1, 2], [3, 4]]
+    // the data is:
+    //  [ 1, 2, 3, 4 ]
+    // A splat literal only has its single value, and becomes a splat attribute
+    // whatever its size. Large literals are copied to a resource blob instead,
+    // which the context neither hashes nor uniques. The blob is named after
+    // the position of the literal, so that the names don't depend on the order
+    // of emission.
+    llvm::ArrayRef<double> data = lit.getData();
+    mlir::ElementsAttr dataAttribute;
+    if (lit.isSplat()) {
+      dataAttribute = mlir::DenseElementsAttr::get(dataType, data.front());
+    } else if (data.size() * sizeof(double) >
+               options.literalResourceThreshold) {
+      LineColumn lineCol = file->getLineColumn(lit.loc());
+      std::string name = ("literal_" + Twine(lineCol.line) + "_" +
+                          Twine(lineCol.col))
+                             .str();
+      dataAttribute = mlir::DenseResourceElementsAttr::get(
+          dataType, name,
+          mlir::HeapAsmResourceBlob::allocateAndCopyInferAlign(
+              data, /*dataIsMutable=*/false));
+    } else {
+      dataAttribute = mlir::DenseElementsAttr::get(dataType, data);
+    }
 
     // Build the MLIR op `toy.constant`. This invokes the `ConstantOp::build`
     // method.
     return builder.create<ConstantOp>(loc(lit.loc()), type, dataAttribute);
   }
 
-  /// Recursive helper function to accumulate the data that compose an array
-  /// literal. It flattens the nested structure in the supplied vector. For
-  /// example with this array:
-  ///  [[1, 2], [3, 4]]
-  /// we will generate:
-  ///  [ 1, 2, 3, 4 ]
-  /// Individual numbers are represented as doubles.
-  /// Attributes are the way MLIR attaches constant to operations.
-  void collectData(ExprAST &expr, std::vector<double> &data) {
-    if (auto *lit = dyn_cast<LiteralExprAST>(&expr)) {
-      for (auto &value : lit->getValues())
-        collectData(*value, data);
-      return;
-    }
-
-    assert(isa<NumberExprAST>(expr) && "expected literal or number expr");
-    data.push_back(cast<NumberExprAST>(expr).getValue());
-  }
-
-  /// Emit a call expression. It emits specific operations for the `transpose`
-  /// builtin. Other identifiers are assumed to be user-defined functions.
-  mlir::Value mlirGen(CallExprAST &call) {
+  /// Emit a call expression, once its operands have been emitted. It emits
+  /// specific operations for the `transpose` builtin. Other identifiers are
+  /// assumed to be user-defined functions.
+  mlir::Value mlirGen(CallExprAST &call, ArrayRef<mlir::Value> operands) {
     llvm::StringRef callee = call.getCallee();
     auto location = loc(call.loc());
 
-    // Codegen the operands first.
-    SmallVector<mlir::Value, 4> operands;
-    for (auto &expr : call.getArgs()) {
-      auto arg = mlirGen(*expr);
-      if (!arg)
-        return nullptr;
-      operands.push_back(arg);
-    }
-
     // Builtin calls have their custom operation, meaning this is a
     // straightforward emission.
     if (callee == "transpose") {
       if (call.getArgs().size() != 1) {
-        emitError(location, "MLIR codegen encountered an error: toy.transpose "
-                            "does not accept multiple arguments");
+        emitError(fileLoc(call.loc()),
+                  "MLIR codegen encountered an error: toy.transpose "
+                  "does not accept multiple arguments");
         return nullptr;
       }
       return builder.create<TransposeOp>(location, operands[0]);
@@ -346,30 +444,116 @@ private:
     return mlir::success();
   }
 
+  /// Emit a save operation, writing its argument to a `.npy` file.
+  mlir::LogicalResult mlirGen(SaveExprAST &call) {
+    auto arg = mlirGen(*call.getArg());
+    if (!arg)
+      return mlir::failure();
+
+    builder.create<SaveOp>(loc(call.loc()), arg, call.getPath());
+    return mlir::success();
+  }
+
   /// Emit a constant for a single number (FIXME: semantic? broadcast?)
   mlir::Value mlirGen(NumberExprAST &num) {
     return builder.create<ConstantOp>(loc(num.loc()), num.getValue());
   }
 
-  /// Dispatch codegen for the right expression subclass using RTTI.
-  mlir::Value mlirGen(ExprAST &expr) {
-    switch (expr.getKind()) {
-    case toy::ExprAST::Expr_BinOp:
-      return mlirGen(cast<BinaryExprAST>(expr));
-    case toy::ExprAST::Expr_Var:
-      return mlirGen(cast<VariableExprAST>(expr));
-    case toy::ExprAST::Expr_Literal:
-      return mlirGen(cast<LiteralExprAST>(expr));
-    case toy::ExprAST::Expr_Call:
-      return mlirGen(cast<CallExprAST>(expr));
-    case toy::ExprAST::Expr_Num:
-      return mlirGen(cast<NumberExprAST>(expr));
-    default:
-      emitError(loc(expr.loc()))
-          << "MLIR codegen encountered an unhandled expr kind '"
-          << Twine(expr.getKind()) << "'";
+  /// Emit a constant for the tensor stored in a `.npy` file, for a call to the
+  /// load builtin. The file is mapped in memory and its content becomes the
+  /// blob of a resource attribute, without being parsed or copied: the mapping
+  /// is released when the blob is, with the context. Relative paths are
+  /// resolved from the current directory.
+  mlir::Value mlirGen(LoadExprAST &load) {
+    auto location = loc(load.loc());
+    llvm::Expected<NpyArray> array = readNpyFile(load.getPath());
+    if (!array) {
+      emitError(fileLoc(load.loc()), "error: cannot load '")
+          << load.getPath() << "': " << llvm::toString(array.takeError());
       return nullptr;
     }
+    auto type =
+        mlir::RankedTensorType::get(array->shape, builder.getF64Type());
+
+    // Name the blob after the file. The name must be an identifier, and is
+    // made unique by the context if several files have the same name.
+    std::string name = llvm::sys::path::stem(load.getPath()).str();
+    for (char &c : name)
+      if (!llvm::isAlnum(c))
+        c = '_';
+    if (name.empty() || llvm::isDigit(name.front()))
+      name.insert(0, "npy_");
+
+    ArrayRef<char> data(reinterpret_cast<const char *>(array->data.data()),
+                        array->data.size() * sizeof(double));
+    mlir::AsmResourceBlob blob(
+        data, alignof(double),
+        [buffer = std::move(array->buffer)](void *, size_t, size_t) mutable {
+          buffer.reset();
+        },
+        /*dataIsMutable=*/false);
+    auto dataAttribute =
+        mlir::DenseResourceElementsAttr::get(type, name, std::move(blob));
+    return builder.create<ConstantOp>(location, type, dataAttribute);
+  }
+
+  /// Dispatch codegen for the right expression subclass with the visitor. The
+  /// operands are emitted first, from left to right, in a post-order walk with
+  /// an explicit stack: generated code can nest expressions deeper than the
+  /// native stack allows. If an error occurs we get a nullptr and propagate.
+  mlir::Value mlirGen(ExprAST &root) {
+    size_t numOperandValues = operandValues.size();
+    // The expressions to emit, with whether their operands were scheduled.
+    SmallVector<std::pair<ExprAST *, bool>, 16> worklist = {{&root, false}};
+    while (!worklist.empty()) {
+      auto &[expr, operandsScheduled] = worklist.back();
+      if (!operandsScheduled) {
+        operandsScheduled = true;
+        llvm::MutableArrayRef<ExprAST *> operands = getOperands(expr);
+        for (ExprAST *operand : llvm::reverse(operands))
+          worklist.push_back({operand, false});
+        continue;
+      }
+      mlir::Value value = visit(worklist.pop_back_val().first);
+      if (!value) {
+        operandValues.truncate(numOperandValues);
+        return nullptr;
+      }
+      operandValues.push_back(value);
+    }
+    return operandValues.pop_back_val();
+  }
+
+  // The visitor dispatches the expressions to the methods below, once the
+  // values of their operands have been pushed to `operandValues` in order.
+  friend ASTVisitor<MLIRGenImpl, mlir::Value>;
+
+  mlir::Value visitBinaryExpr(BinaryExprAST *binop) {
+    mlir::Value rhs = operandValues.pop_back_val();
+    mlir::Value lhs = operandValues.pop_back_val();
+    return mlirGen(*binop, lhs, rhs);
+  }
+
+  mlir::Value visitCallExpr(CallExprAST *call) {
+    size_t numArgs = call->getArgs().size();
+    mlir::Value value =
+        mlirGen(*call, ArrayRef(operandValues).take_back(numArgs));
+    operandValues.truncate(operandValues.size() - numArgs);
+    return value;
+  }
+
+  mlir::Value visitVariableExpr(VariableExprAST *expr) {
+    return mlirGen(*expr);
+  }
+  mlir::Value visitLiteralExpr(LiteralExprAST *lit) { return mlirGen(*lit); }
+  mlir::Value visitNumberExpr(NumberExprAST *num) { return mlirGen(*num); }
+  mlir::Value visitLoadExpr(LoadExprAST *load) { return mlirGen(*load); }
+
+  mlir::Value visitExpr(ExprAST *expr) {
+    emitError(fileLoc(expr->loc()))
+        << "MLIR codegen encountered an unhandled expr kind '"
+        << Twine(expr->getKind()) << "'";
+    return nullptr;
   }
 
   /// Handle a variable declaration, we'll codegen the expression that forms the
@@ -379,7 +563,7 @@ private:
   mlir::Value mlirGen(VarDeclExprAST &vardecl) {
     auto *init = vardecl.getInitVal();
     if (!init) {
-      emitError(loc(vardecl.loc()),
+      emitError(fileLoc(vardecl.loc()),
                 "missing initializer in variable declaration");
       return nullptr;
     }
@@ -402,29 +586,45 @@ private:
     return value;
   }
 
+  /// Visitor emitting the statements of a block. Variable declarations,
+  /// return statements, print and save can only appear in block list and not
+  /// in nested expressions, so they are dispatched here. Other expressions are
+  /// emitted for their value.
+  class StatementEmitter
+      : public ASTVisitor<StatementEmitter, mlir::LogicalResult> {
+  public:
+    StatementEmitter(MLIRGenImpl &gen) : gen(gen) {}
+
+    mlir::LogicalResult visitVarDeclExpr(VarDeclExprAST *vardecl) {
+      return mlir::success(bool(gen.mlirGen(*vardecl)));
+    }
+    mlir::LogicalResult visitReturnExpr(ReturnExprAST *ret) {
+      return gen.mlirGen(*ret);
+    }
+    mlir::LogicalResult visitPrintExpr(PrintExprAST *print) {
+      return gen.mlirGen(*print);
+    }
+    mlir::LogicalResult visitSaveExpr(SaveExprAST *save) {
+      return gen.mlirGen(*save);
+    }
+    mlir::LogicalResult visitExpr(ExprAST *expr) {
+      return mlir::success(bool(gen.mlirGen(*expr)));
+    }
+
+  private:
+    MLIRGenImpl &gen;
+  };
+
   /// Codegen a list of expression, return failure if one of them hit an error.
   mlir::LogicalResult mlirGen(ExprASTList &blockAST) {
     ScopedHashTableScope<StringRef, mlir::Value> varScope(symbolTable);
-    for (auto &expr : blockAST) {
-      // Specific handling for variable declarations, return statement, and
-      // print. These can only appear in block list and not in nested
-      // expressions.
-      if (auto *vardecl = dyn_cast<VarDeclExprAST>(expr.get())) {
-        if (!mlirGen(*vardecl))
-          return mlir::failure();
-        continue;
-      }
-      if (auto *ret = dyn_cast<ReturnExprAST>(expr.get()))
-        return mlirGen(*ret);
-      if (auto *print = dyn_cast<PrintExprAST>(expr.get())) {
-        if (mlir::failed(mlirGen(*print)))
-          return mlir::success();
-        continue;
-      }
-
-      // Generic expression dispatch codegen.
-      if (!mlirGen(*expr))
+    StatementEmitter emitter(*this);
+    for (auto *expr : blockAST) {
+      if (mlir::failed(emitter.visit(expr)))
         return mlir::failure();
+      // Nothing past a return statement is emitted.
+      if (isa<ReturnExprAST>(expr))
+        break;
     }
     return mlir::success();
   }
@@ -450,8 +650,14 @@ namespace toy {
 
 // The public API for codegen.
 mlir::OwningOpRef<mlir::ModuleOp> mlirGen(mlir::MLIRContext &context,
-                                          ModuleAST &moduleAST) {
-  return MLIRGenImpl(context).mlirGen(moduleAST);
+                                          ModuleAST &moduleAST,
+                                          MLIRGenOptions options) {
+  return MLIRGenImpl(context, options).mlirGen(moduleAST);
+}
+
+mlir::LogicalResult mlirGen(mlir::ModuleOp module, ModuleAST &moduleAST,
+                            MLIRGenOptions options) {
+  return MLIRGenImpl(*module.getContext(), options).mlirGen(module, moduleAST);
 }
 
 } // namespace toy
@@ -0,0 +1,113 @@
+//===- ShapeInferencePass.cpp - Shape Inference ---------------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a Function level pass performing intra-procedural
+// propagation of array shapes, from the constants and reshapes of a function
+// to the operations computed from them.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/IR/BuiltinTypes.h"
+#include "mlir/IR/Operation.h"
+#include "mlir/IR/Types.h"
+#include "mlir/Pass/Pass.h"
+#include "mlir/Support/LLVM.h"
+#include "mlir/Support/TypeID.h"
+#include "toy/Dialect.h"
+#include "toy/Passes.h"
+#include "toy/ShapeInferenceInterface.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <memory>
+
+#define DEBUG_TYPE "shape-inference"
+
+using namespace mlir;
+using namespace toy;
+
+namespace {
+/// The ShapeInferencePass is a pass that performs intra-procedural
+/// shape inference.
+///
+///    Algorithm:
+///
+///   1) Build a worklist containing all the operations that return a
+///      dynamically shaped tensor and whose operands all have static shapes,
+///      in program order.
+///   2) Iterate on the worklist:
+///     a) pop an operation and infer its output shapes with the interface;
+///     b) add the users of its results that now have static operands only.
+///
+/// Every operation is inferred at most once and only looks at its direct
+/// users, so the pass is linear in the size of the function. Operations that
+/// depend on values of unknown shapes, such as the arguments of a generic
+/// function or the results of calls, keep their dynamic shapes: they are
+/// inferred once the calls are inlined.
+struct ShapeInferencePass
+    : public mlir::PassWrapper<ShapeInferencePass, OperationPass<toy::FuncOp>> {
+  MLIR_DEFINE_EXPLICIT_INTERNAL_INLINE_TYPE_ID(ShapeInferencePass)
+
+  StringRef getArgument() const final { return "toy-shape-inference"; }
+  StringRef getDescription() const final {
+    return "Infer the static shapes of the results of Toy operations";
+  }
+
+  void runOnOperation() override {
+    llvm::SmallVector<Operation *, 64> worklist;
+    getOperation().walk([&](Operation *op) {
+      if (isReadyToInfer(op))
+        worklist.push_back(op);
+    });
+
+    // Pop from the back, after reversing, to infer in program order.
+    std::reverse(worklist.begin(), worklist.end());
+    while (!worklist.empty()) {
+      Operation *op = worklist.pop_back_val();
+      // An operation using the same value twice is added once per use.
+      if (!returnsDynamicShape(op))
+        continue;
+      LLVM_DEBUG(llvm::dbgs() << "Inferring shape for: " << *op << "\n");
+      llvm::cast<ShapeInference>(op).inferShapes();
+      for (Operation *user : op->getUsers())
+        if (isReadyToInfer(user))
+          worklist.push_back(user);
+    }
+  }
+
+  /// A utility method that returns if the given operation has all of its
+  /// operands inferred.
+  static bool allOperandsInferred(Operation *op) {
+    return llvm::all_of(op->getOperandTypes(), [](Type operandType) {
+      return llvm::isa<RankedTensorType>(operandType);
+    });
+  }
+
+  /// A utility method that returns if the given operation has a dynamically
+  /// shaped result.
+  static bool returnsDynamicShape(Operation *op) {
+    return llvm::any_of(op->getResultTypes(), [](Type resultType) {
+      return !llvm::isa<RankedTensorType>(resultType);
+    });
+  }
+
+  /// Return whether the shapes of `op` are still to be inferred and can be.
+  static bool isReadyToInfer(Operation *op) {
+    return llvm::isa<ShapeInference>(op) && returnsDynamicShape(op) &&
+           allOperandsInferred(op);
+  }
+};
+} // namespace
+
+/// Create a Shape Inference pass.
+std::unique_ptr<mlir::Pass> mlir::toy::createShapeInferencePass() {
+  return std::make_unique<ShapeInferencePass>();
+}
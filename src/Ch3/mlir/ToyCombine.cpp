@@ -11,6 +11,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/IR/BuiltinAttributes.h"
 #include "mlir/IR/MLIRContext.h"
 #include "mlir/IR/PatternMatch.h"
 #include "mlir/IR/Value.h"
@@ -19,6 +20,18 @@
 using namespace mlir;
 using namespace toy;
 
+/// Return the value of a constant with the type of `result`. A resource blob is
+/// shared with the new value rather than copied, and a splat stays a splat.
+static ElementsAttr reshapeConstant(ElementsAttr value, Value result) {
+  auto type = llvm::cast<ShapedType>(result.getType());
+  if (auto resource = llvm::dyn_cast<DenseResourceElementsAttr>(value))
+    return DenseResourceElementsAttr::get(type, resource.getRawHandle());
+  auto dense = llvm::cast<DenseElementsAttr>(value);
+  if (dense.isSplat())
+    return DenseElementsAttr::get(type, dense.getSplatValue<Attribute>());
+  return dense.reshape(type);
+}
+
 namespace {
 /// Include the patterns defined in the Declarative Rewrite framework.
 #include "ToyCombine.inc"
@@ -13,11 +13,13 @@
 #include "toy/AST.h"
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Twine.h"
-#include "llvm/ADT/TypeSwitch.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/raw_ostream.h"
+#include <optional>
 #include <string>
+#include <utility>
 
 using namespace toy;
 
@@ -32,199 +34,286 @@ struct Indent {
 };
 
 /// Helper class that implement the AST tree traversal and print the nodes along
-/// the way. The only data member is the current indentation level.
-class ASTDumper {
+/// the way. Expressions are traversed with an explicit worklist rather than by
+/// recursion, as generated code can nest them deeper than the native stack
+/// allows.
+class ASTDumper : public ASTVisitor<ASTDumper> {
 public:
+  ASTDumper(llvm::raw_ostream &os, std::optional<size_t> literalLimit)
+      : os(os), literalLimit(literalLimit) {}
+
   void dump(ModuleAST *node);
 
 private:
+  friend ASTVisitor<ASTDumper>;
+
   void dump(const VarType &type);
-  void dump(VarDeclExprAST *varDecl);
   void dump(ExprAST *expr);
   void dump(ExprASTList *exprList);
-  void dump(NumberExprAST *num);
-  void dump(LiteralExprAST *node);
-  void dump(VariableExprAST *node);
-  void dump(ReturnExprAST *node);
-  void dump(BinaryExprAST *node);
-  void dump(CallExprAST *node);
-  void dump(PrintExprAST *node);
   void dump(PrototypeAST *node);
   void dump(FunctionAST *node);
 
+  void visitVarDeclExpr(VarDeclExprAST *varDecl);
+  void visitNumberExpr(NumberExprAST *num);
+  void visitLiteralExpr(LiteralExprAST *node);
+  void visitVariableExpr(VariableExprAST *node);
+  void visitReturnExpr(ReturnExprAST *node);
+  void visitBinaryExpr(BinaryExprAST *node);
+  void visitCallExpr(CallExprAST *node);
+  void visitPrintExpr(PrintExprAST *node);
+  void visitLoadExpr(LoadExprAST *node);
+  void visitSaveExpr(SaveExprAST *node);
+  void visitExpr(ExprAST *expr);
+
   // Actually print spaces matching the current indentation level
   void indent() {
     for (int i = 0; i < curIndent; i++)
-      llvm::errs() << "  ";
+      os << "  ";
   }
   int curIndent = 0;
+
+  /// Schedule an expression to be printed at the current indentation level
+  /// once the previously scheduled ones are done. A null expression stands for
+  /// the closing bracket of a call.
+  void schedule(ExprAST *expr) { worklist.push_back({expr, curIndent}); }
+  llvm::SmallVector<std::pair<ExprAST *, int>, 16> worklist;
+
+  /// Return a formatted string for the location of any node
+  template <typename T>
+  std::string loc(T *node) {
+    LineColumn lineCol = file->getLineColumn(node->loc());
+    return (llvm::Twine("@") + file->getName() + ":" +
+            llvm::Twine(lineCol.line) + ":" + llvm::Twine(lineCol.col))
+        .str();
+  }
+
+  /// The stream the AST is printed to.
+  llvm::raw_ostream &os;
+
+  /// The number of values above which literals are summarized, if any.
+  std::optional<size_t> literalLimit;
+
+  /// The file the locations of the module being dumped refer to.
+  const SourceFile *file = nullptr;
 };
 
 } // namespace
 
-/// Return a formatted string for the location of any node
-template <typename T>
-static std::string loc(T *node) {
-  const auto &loc = node->loc();
-  return (llvm::Twine("@") + *loc.file + ":" + llvm::Twine(loc.line) + ":" +
-          llvm::Twine(loc.col))
-      .str();
-}
-
 // Helper Macro to bump the indentation level and print the leading spaces for
 // the current indentations
 #define INDENT()                                                               \
   Indent level_(curIndent);                                                    \
   indent();
 
-/// Dispatch to a generic expressions to the appropriate subclass using RTTI
-void ASTDumper::dump(ExprAST *expr) {
-  llvm::TypeSwitch<ExprAST *>(expr)
-      .Case<BinaryExprAST, CallExprAST, LiteralExprAST, NumberExprAST,
-            PrintExprAST, ReturnExprAST, VarDeclExprAST, VariableExprAST>(
-          [&](auto *node) { this->dump(node); })
-      .Default([&](ExprAST *) {
-        // No match, fallback to a generic message
-        INDENT();
-        llvm::errs() << "<unknown Expr, kind " << expr->getKind() << ">\n";
-      });
+/// Print an expression and its operands. Each node prints its own line and
+/// schedules its operands, which are then dispatched to the appropriate
+/// subclass by the visitor.
+void ASTDumper::dump(ExprAST *root) {
+  int savedIndent = curIndent;
+  schedule(root);
+  while (!worklist.empty()) {
+    auto [expr, level] = worklist.pop_back_val();
+    curIndent = level;
+    if (!expr) {
+      indent();
+      os << "]\n";
+      continue;
+    }
+    visit(expr);
+  }
+  curIndent = savedIndent;
+}
+
+/// No match, fallback to a generic message
+void ASTDumper::visitExpr(ExprAST *expr) {
+  INDENT();
+  os << "<unknown Expr, kind " << expr->getKind() << ">\n";
 }
 
 /// A variable declaration is printing the variable name, the type, and then
-/// recurse in the initializer value.
-void ASTDumper::dump(VarDeclExprAST *varDecl) {
+/// the initializer value.
+void ASTDumper::visitVarDeclExpr(VarDeclExprAST *varDecl) {
   INDENT();
-  llvm::errs() << "VarDecl " << varDecl->getName();
+  os << "VarDecl " << varDecl->getName();
   dump(varDecl->getType());
-  llvm::errs() << " " << loc(varDecl) << "\n";
-  dump(varDecl->getInitVal());
+  os << " " << loc(varDecl) << "\n";
+  schedule(varDecl->getInitVal());
 }
 
 /// A "block", or a list of expression
 void ASTDumper::dump(ExprASTList *exprList) {
   INDENT();
-  llvm::errs() << "Block {\n";
-  for (auto &expr : *exprList)
-    dump(expr.get());
+  os << "Block {\n";
+  for (auto *expr : *exprList)
+    dump(expr);
   indent();
-  llvm::errs() << "} // Block\n";
+  os << "} // Block\n";
 }
 
 /// A literal number, just print the value.
-void ASTDumper::dump(NumberExprAST *num) {
+void ASTDumper::visitNumberExpr(NumberExprAST *num) {
   INDENT();
-  llvm::errs() << num->getValue() << " " << loc(num) << "\n";
+  os << num->getValue() << " " << loc(num) << "\n";
 }
 
-/// Helper to print recursively a literal. This handles nested array like:
+/// Helper to print a literal. This handles nested array like:
 ///    [ [ 1, 2 ], [ 3, 4 ] ]
 /// We print out such array with the dimensions spelled out at every level:
 ///    <2,2>[<2>[ 1, 2 ], <2>[ 3, 4 ] ]
-void printLitHelper(ExprAST *litOrNum) {
-  // Inside a literal expression we can have either a number or another literal
-  if (auto *num = llvm::dyn_cast<NumberExprAST>(litOrNum)) {
-    llvm::errs() << num->getValue();
-    return;
-  }
-  auto *literal = llvm::cast<LiteralExprAST>(litOrNum);
+/// The values of the literal are stored flattened, so the nested lists are
+/// printed in a single pass over them: before each value, the lists ending at
+/// the previous one are closed and the lists starting at this one are opened.
+/// Splat literals are printed in full like the others.
+static void printLitHelper(llvm::raw_ostream &os, LiteralExprAST *literal) {
+  llvm::ArrayRef<int64_t> dims = literal->getDims();
+  // Open the lists from the given nesting level inwards, printing the
+  // dimensions of each of them first.
+  auto open = [&](size_t level) {
+    for (size_t l = level, e = dims.size(); l != e; ++l) {
+      os << "<";
+      llvm::interleaveComma(dims.drop_front(l), os);
+      os << ">[ ";
+    }
+  };
+  auto close = [&](size_t level) {
+    for (size_t l = level, e = dims.size(); l != e; ++l)
+      os << "]";
+  };
 
-  // Print the dimension for this literal first
-  llvm::errs() << "<";
-  llvm::interleaveComma(literal->getDims(), llvm::errs());
-  llvm::errs() << ">";
+  // The number of values in a list at each nesting level.
+  llvm::SmallVector<size_t, 4> spans(dims.size());
+  size_t span = 1;
+  for (size_t l = dims.size(); l-- != 0;)
+    spans[l] = span *= dims[l];
 
-  // Now print the content, recursing on every element of the list
-  llvm::errs() << "[ ";
-  llvm::interleaveComma(literal->getValues(), llvm::errs(),
-                        [&](auto &elt) { printLitHelper(elt.get()); });
-  llvm::errs() << "]";
+  open(0);
+  for (size_t i = 0, e = literal->getNumElements(); i != e; ++i) {
+    if (i != 0) {
+      size_t level = dims.size();
+      while (level > 1 && i % spans[level - 1] == 0)
+        --level;
+      close(level);
+      os << ", ";
+      open(level);
+    }
+    os << literal->getValue(i);
+  }
+  close(0);
 }
 
-/// Print a literal, see the recursive helper above for the implementation.
-void ASTDumper::dump(LiteralExprAST *node) {
+/// Print a literal, see the helper above for the implementation. A literal
+/// with more values than the limit is summarized as its dimensions, its first
+/// values and their number:
+///    <2,3>[ 1, 2, ... 6 values ]
+void ASTDumper::visitLiteralExpr(LiteralExprAST *node) {
   INDENT();
-  llvm::errs() << "Literal: ";
-  printLitHelper(node);
-  llvm::errs() << " " << loc(node) << "\n";
+  os << "Literal: ";
+  size_t numElements = node->getNumElements();
+  if (literalLimit && numElements > *literalLimit) {
+    os << "<";
+    llvm::interleaveComma(node->getDims(), os);
+    os << ">[ ";
+    for (size_t i = 0; i != *literalLimit; ++i)
+      os << node->getValue(i) << ", ";
+    os << "... " << numElements << " values ]";
+  } else {
+    printLitHelper(os, node);
+  }
+  os << " " << loc(node) << "\n";
 }
 
 /// Print a variable reference (just a name).
-void ASTDumper::dump(VariableExprAST *node) {
+void ASTDumper::visitVariableExpr(VariableExprAST *node) {
   INDENT();
-  llvm::errs() << "var: " << node->getName() << " " << loc(node) << "\n";
+  os << "var: " << node->getName() << " " << loc(node) << "\n";
 }
 
 /// Return statement print the return and its (optional) argument.
-void ASTDumper::dump(ReturnExprAST *node) {
+void ASTDumper::visitReturnExpr(ReturnExprAST *node) {
   INDENT();
-  llvm::errs() << "Return\n";
+  os << "Return\n";
   if (node->getExpr().has_value())
-    return dump(*node->getExpr());
+    return schedule(*node->getExpr());
   {
     INDENT();
-    llvm::errs() << "(void)\n";
+    os << "(void)\n";
   }
 }
 
-/// Print a binary operation, first the operator, then recurse into LHS and RHS.
-void ASTDumper::dump(BinaryExprAST *node) {
+/// Print a binary operation, first the operator, then LHS and RHS. Operands
+/// are scheduled in reverse order, as the last scheduled is printed first.
+void ASTDumper::visitBinaryExpr(BinaryExprAST *node) {
   INDENT();
-  llvm::errs() << "BinOp: " << node->getOp() << " " << loc(node) << "\n";
-  dump(node->getLHS());
-  dump(node->getRHS());
+  os << "BinOp: " << node->getOp() << " " << loc(node) << "\n";
+  schedule(node->getRHS());
+  schedule(node->getLHS());
 }
 
-/// Print a call expression, first the callee name and the list of args by
-/// recursing into each individual argument.
-void ASTDumper::dump(CallExprAST *node) {
+/// Print a call expression, first the callee name and the list of args, then
+/// the closing bracket.
+void ASTDumper::visitCallExpr(CallExprAST *node) {
   INDENT();
-  llvm::errs() << "Call '" << node->getCallee() << "' [ " << loc(node) << "\n";
-  for (auto &arg : node->getArgs())
-    dump(arg.get());
-  indent();
-  llvm::errs() << "]\n";
+  os << "Call '" << node->getCallee() << "' [ " << loc(node) << "\n";
+  schedule(nullptr);
+  for (auto *arg : llvm::reverse(node->getArgs()))
+    schedule(arg);
 }
 
 /// Print a builtin print call, first the builtin name and then the argument.
-void ASTDumper::dump(PrintExprAST *node) {
+void ASTDumper::visitPrintExpr(PrintExprAST *node) {
   INDENT();
-  llvm::errs() << "Print [ " << loc(node) << "\n";
-  dump(node->getArg());
-  indent();
-  llvm::errs() << "]\n";
+  os << "Print [ " << loc(node) << "\n";
+  schedule(nullptr);
+  schedule(node->getArg());
+}
+
+/// Print a builtin load call, with the path of the file to load.
+void ASTDumper::visitLoadExpr(LoadExprAST *node) {
+  INDENT();
+  os << "Load \"" << node->getPath() << "\" " << loc(node) << "\n";
+}
+
+/// Print a builtin save call, first the path of the file to write and then the
+/// argument.
+void ASTDumper::visitSaveExpr(SaveExprAST *node) {
+  INDENT();
+  os << "Save \"" << node->getPath() << "\" [ " << loc(node) << "\n";
+  schedule(nullptr);
+  schedule(node->getArg());
 }
 
 /// Print type: only the shape is printed in between '<' and '>'
 void ASTDumper::dump(const VarType &type) {
-  llvm::errs() << "<";
-  llvm::interleaveComma(type.shape, llvm::errs());
-  llvm::errs() << ">";
+  os << "<";
+  llvm::interleaveComma(type.shape, os);
+  os << ">";
 }
 
 /// Print a function prototype, first the function name, and then the list of
 /// parameters names.
 void ASTDumper::dump(PrototypeAST *node) {
   INDENT();
-  llvm::errs() << "Proto '" << node->getName() << "' " << loc(node) << "\n";
+  os << "Proto '" << node->getName() << "' " << loc(node) << "\n";
   indent();
-  llvm::errs() << "Params: [";
-  llvm::interleaveComma(node->getArgs(), llvm::errs(),
-                        [](auto &arg) { llvm::errs() << arg->getName(); });
-  llvm::errs() << "]\n";
+  os << "Params: [";
+  llvm::interleaveComma(node->getArgs(), os,
+                        [&](auto *arg) { os << arg->getName(); });
+  os << "]\n";
 }
 
 /// Print a function, first the prototype and then the body.
 void ASTDumper::dump(FunctionAST *node) {
   INDENT();
-  llvm::errs() << "Function \n";
+  os << "Function \n";
   dump(node->getProto());
   dump(node->getBody());
 }
 
 /// Print a module, actually loop over the functions and print them in sequence.
 void ASTDumper::dump(ModuleAST *node) {
+  file = &node->getSourceFile();
   INDENT();
-  llvm::errs() << "Module:\n";
+  os << "Module:\n";
   for (auto &f : *node)
     dump(&f);
 }
@@ -232,6 +321,9 @@ void ASTDumper::dump(ModuleAST *node) {
 namespace toy {
 
 // Public API
-void dump(ModuleAST &module) { ASTDumper().dump(&module); }
+void dump(ModuleAST &module, llvm::raw_ostream &os,
+          std::optional<size_t> literalLimit) {
+  ASTDumper(os, literalLimit).dump(&module);
+}
 
 } // namespace toy
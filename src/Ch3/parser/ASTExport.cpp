@@ -0,0 +1,280 @@
+//===- ASTExport.cpp - Machine-readable outputs of the Toy AST ------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the export of a Toy AST as JSON and in a compact binary
+// format. Like the AST dump, expressions are traversed with an explicit
+// worklist rather than by recursion, as generated code can nest them deeper
+// than the native stack allows.
+//
+//===----------------------------------------------------------------------===//
+
+#include "toy/ASTExport.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/bit.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/SwapByteOrder.h"
+#include <algorithm>
+#include <cstdint>
+
+using namespace toy;
+
+/// The names of the kinds of expressions, indexed by ExprASTKind.
+static const char *const kindNames[] = {
+    "VarDecl", "Return", "Num",   "Literal", "Var",
+    "BinOp",   "Call",   "Print", "Load",    "Save",
+};
+
+/// Return the number of values of `literal` to export, the first
+/// `literalLimit` ones. The values of splat literals are repeated.
+static size_t getNumExportedValues(LiteralExprAST *literal,
+                                   std::optional<size_t> literalLimit) {
+  size_t numElements = literal->getNumElements();
+  return literalLimit ? std::min(numElements, *literalLimit) : numElements;
+}
+
+namespace {
+
+/// Exports a module as JSON. The visitor writes the fields specific to the
+/// class of each expression.
+class JSONExporter : public ASTVisitor<JSONExporter> {
+public:
+  JSONExporter(llvm::raw_ostream &os, std::optional<size_t> literalLimit)
+      : json(os), literalLimit(literalLimit) {}
+
+  void exportModule(ModuleAST &module) {
+    file = &module.getSourceFile();
+    json.object([&] {
+      json.attribute("file", file->getName());
+      json.attributeArray("functions", [&] {
+        for (FunctionAST &function : module)
+          exportFunction(function);
+      });
+    });
+  }
+
+  void visitVarDeclExpr(VarDeclExprAST *varDecl) {
+    json.attribute("name", varDecl->getName());
+    json.attributeArray("shape", [&] {
+      for (int64_t dim : varDecl->getType().shape)
+        json.value(dim);
+    });
+  }
+  void visitNumberExpr(NumberExprAST *num) {
+    json.attribute("value", num->getValue());
+  }
+  void visitLiteralExpr(LiteralExprAST *literal) {
+    json.attributeArray("dims", [&] {
+      for (int64_t dim : literal->getDims())
+        json.value(dim);
+    });
+    json.attribute("count",
+                   static_cast<int64_t>(literal->getNumElements()));
+    json.attributeArray("values", [&] {
+      for (size_t i = 0, e = getNumExportedValues(literal, literalLimit);
+           i != e; ++i)
+        json.value(literal->getValue(i));
+    });
+  }
+  void visitVariableExpr(VariableExprAST *var) {
+    json.attribute("name", var->getName());
+  }
+  void visitBinaryExpr(BinaryExprAST *binOp) {
+    char op = binOp->getOp();
+    json.attribute("op", llvm::StringRef(&op, 1));
+  }
+  void visitCallExpr(CallExprAST *call) {
+    json.attribute("callee", call->getCallee());
+  }
+  void visitLoadExpr(LoadExprAST *load) {
+    json.attribute("path", load->getPath());
+  }
+  void visitSaveExpr(SaveExprAST *save) {
+    json.attribute("path", save->getPath());
+  }
+
+private:
+  void exportLocation(Location loc) {
+    LineColumn lineCol = file->getLineColumn(loc);
+    json.attribute("line", lineCol.line);
+    json.attribute("col", lineCol.col);
+  }
+
+  void exportFunction(FunctionAST &function) {
+    PrototypeAST *proto = function.getProto();
+    json.object([&] {
+      json.attribute("name", proto->getName());
+      exportLocation(proto->loc());
+      json.attributeArray("params", [&] {
+        for (VariableExprAST *param : proto->getArgs())
+          json.value(param->getName());
+      });
+      json.attributeArray("body", [&] {
+        for (ExprAST *expr : *function.getBody())
+          exportExpr(expr);
+      });
+    });
+  }
+
+  void exportExpr(ExprAST *root) {
+    // A null entry closes the operands of an expression.
+    llvm::SmallVector<ExprAST *, 16> worklist = {root};
+    while (!worklist.empty()) {
+      ExprAST *expr = worklist.pop_back_val();
+      if (!expr) {
+        json.arrayEnd();
+        json.attributeEnd();
+        json.objectEnd();
+        continue;
+      }
+      json.objectBegin();
+      json.attribute("kind", kindNames[expr->getKind()]);
+      exportLocation(expr->loc());
+      visit(expr);
+      llvm::MutableArrayRef<ExprAST *> operands = getOperands(expr);
+      if (operands.empty()) {
+        json.objectEnd();
+        continue;
+      }
+      json.attributeBegin("operands");
+      json.arrayBegin();
+      worklist.push_back(nullptr);
+      for (ExprAST *operand : llvm::reverse(operands))
+        worklist.push_back(operand);
+    }
+  }
+
+  llvm::json::OStream json;
+  std::optional<size_t> literalLimit;
+  const SourceFile *file = nullptr;
+};
+
+/// Exports a module in the binary format. The visitor writes the fields
+/// specific to the class of each expression.
+class BinaryExporter : public ASTVisitor<BinaryExporter> {
+public:
+  BinaryExporter(llvm::raw_ostream &os, std::optional<size_t> literalLimit)
+      : os(os), literalLimit(literalLimit) {}
+
+  void exportModule(ModuleAST &module) {
+    file = &module.getSourceFile();
+    os << "TOYAST" << char(formatVersion);
+    writeString(file->getName());
+    writeInt(std::distance(module.begin(), module.end()));
+    for (FunctionAST &function : module) {
+      PrototypeAST *proto = function.getProto();
+      writeString(proto->getName());
+      writeLocation(proto->loc());
+      writeInt(proto->getArgs().size());
+      for (VariableExprAST *param : proto->getArgs())
+        writeString(param->getName());
+      writeInt(function.getBody()->size());
+      for (ExprAST *expr : *function.getBody())
+        exportExpr(expr);
+    }
+  }
+
+  void visitVarDeclExpr(VarDeclExprAST *varDecl) {
+    writeString(varDecl->getName());
+    writeDims(varDecl->getType().shape);
+  }
+  void visitNumberExpr(NumberExprAST *num) { writeDouble(num->getValue()); }
+  void visitLiteralExpr(LiteralExprAST *literal) {
+    writeDims(literal->getDims());
+    size_t numValues = getNumExportedValues(literal, literalLimit);
+    writeInt(literal->getNumElements());
+    writeInt(numValues);
+    // The values are already laid out as expected on little endian hosts.
+    if (llvm::sys::IsLittleEndianHost && !literal->isSplat()) {
+      os.write(reinterpret_cast<const char *>(literal->getData().data()),
+               numValues * sizeof(double));
+      return;
+    }
+    for (size_t i = 0; i != numValues; ++i)
+      writeDouble(literal->getValue(i));
+  }
+  void visitVariableExpr(VariableExprAST *var) { writeString(var->getName()); }
+  void visitBinaryExpr(BinaryExprAST *binOp) { os << binOp->getOp(); }
+  void visitCallExpr(CallExprAST *call) { writeString(call->getCallee()); }
+  void visitLoadExpr(LoadExprAST *load) { writeString(load->getPath()); }
+  void visitSaveExpr(SaveExprAST *save) { writeString(save->getPath()); }
+
+private:
+  /// The version of the format, to be bumped on incompatible changes.
+  static constexpr unsigned formatVersion = 1;
+
+  void writeInt(uint64_t value) { llvm::encodeULEB128(value, os); }
+
+  void writeDouble(double value) {
+    char bytes[sizeof(double)];
+    llvm::support::endian::write64le(bytes, llvm::bit_cast<uint64_t>(value));
+    os.write(bytes, sizeof(bytes));
+  }
+
+  void writeString(llvm::StringRef str) {
+    auto [it, inserted] = strings.try_emplace(str, strings.size());
+    writeInt(it->second);
+    if (inserted) {
+      writeInt(str.size());
+      os << str;
+    }
+  }
+
+  void writeDims(llvm::ArrayRef<int64_t> dims) {
+    writeInt(dims.size());
+    for (int64_t dim : dims)
+      writeInt(dim);
+  }
+
+  void writeLocation(Location loc) {
+    LineColumn lineCol = file->getLineColumn(loc);
+    writeInt(lineCol.line);
+    writeInt(lineCol.col);
+  }
+
+  /// Write the expressions of a tree in pre-order, each one followed by its
+  /// operands.
+  void exportExpr(ExprAST *root) {
+    llvm::SmallVector<ExprAST *, 16> worklist = {root};
+    while (!worklist.empty()) {
+      ExprAST *expr = worklist.pop_back_val();
+      os << char(expr->getKind());
+      writeLocation(expr->loc());
+      visit(expr);
+      llvm::MutableArrayRef<ExprAST *> operands = getOperands(expr);
+      writeInt(operands.size());
+      for (ExprAST *operand : llvm::reverse(operands))
+        worklist.push_back(operand);
+    }
+  }
+
+  llvm::raw_ostream &os;
+  std::optional<size_t> literalLimit;
+  const SourceFile *file = nullptr;
+
+  /// The index of each string written so far, in the order of first use.
+  llvm::StringMap<unsigned> strings;
+};
+
+} // namespace
+
+void toy::exportJSON(ModuleAST &module, llvm::raw_ostream &os,
+                     std::optional<size_t> literalLimit) {
+  JSONExporter(os, literalLimit).exportModule(module);
+  os << "\n";
+}
+
+void toy::exportBinary(ModuleAST &module, llvm::raw_ostream &os,
+                       std::optional<size_t> literalLimit) {
+  BinaryExporter(os, literalLimit).exportModule(module);
+}
@@ -0,0 +1,53 @@
+//===- ASTFold.cpp - Constant folding of the Toy AST ----------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the folding of the arithmetic on numbers in the Toy
+// AST, before the IR is generated.
+//
+//===----------------------------------------------------------------------===//
+
+#include "toy/AST.h"
+
+#include "llvm/Support/Casting.h"
+
+using namespace toy;
+
+namespace {
+
+/// Rewriter replacing a binary operator applied to two numbers by a number.
+/// The operators that the IR generation rejects are left for it to diagnose.
+class ConstantFolder : public ASTRewriter<ConstantFolder> {
+public:
+  ConstantFolder(ASTArena &arena) : arena(arena) {}
+
+  ExprAST *visitBinaryExpr(BinaryExprAST *binop) {
+    auto *lhs = llvm::dyn_cast<NumberExprAST>(binop->getLHS());
+    auto *rhs = llvm::dyn_cast<NumberExprAST>(binop->getRHS());
+    if (!lhs || !rhs)
+      return binop;
+    switch (binop->getOp()) {
+    case '+':
+      return arena.create<NumberExprAST>(binop->loc(),
+                                         lhs->getValue() + rhs->getValue());
+    case '*':
+      return arena.create<NumberExprAST>(binop->loc(),
+                                         lhs->getValue() * rhs->getValue());
+    default:
+      return binop;
+    }
+  }
+
+private:
+  ASTArena &arena;
+};
+
+} // namespace
+
+void toy::foldConstants(ModuleAST &module) {
+  ConstantFolder(module.getArena()).rewrite(module);
+}
@@ -0,0 +1,214 @@
+//===- LexerScan.cpp - Vectorized scanning kernels for the Toy lexer ------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the scanning kernels used by the Toy lexer. The vector
+// kernels process 16 (SSE2) or 32 (AVX2) bytes at a time: they compute a mask
+// of the characters belonging to the run and locate its end with a bit scan.
+// The remaining tail of the buffer is always handled by the scalar kernels.
+//
+//===----------------------------------------------------------------------===//
+
+#include "toy/LexerScan.h"
+
+#include <bit>
+#include <cstdint>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define TOY_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace toy;
+
+//===----------------------------------------------------------------------===//
+// Scalar kernels
+//===----------------------------------------------------------------------===//
+
+/// Same as `isspace` in the "C" locale: ' ', '\t', '\n', '\v', '\f', '\r'.
+static bool isSpaceChar(char c) {
+  return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+}
+
+static bool isNumberChar(char c) {
+  return static_cast<unsigned char>(c - '0') <= 9 || c == '.';
+}
+
+static const char *skipWhitespaceScalar(const char *cur, const char *end) {
+  while (cur != end && isSpaceChar(*cur))
+    ++cur;
+  return cur;
+}
+
+static const char *skipToLineEndScalar(const char *cur, const char *end) {
+  while (cur != end && *cur != '\n' && *cur != '\r' && *cur != '\0')
+    ++cur;
+  return cur;
+}
+
+static const char *skipNumberScalar(const char *cur, const char *end) {
+  while (cur != end && isNumberChar(*cur))
+    ++cur;
+  return cur;
+}
+
+static const ScanKernels scalarKernels = {
+    skipWhitespaceScalar, skipToLineEndScalar, skipNumberScalar,
+    ScanISA::Scalar};
+
+//===----------------------------------------------------------------------===//
+// Vector kernels
+//===----------------------------------------------------------------------===//
+
+#ifdef TOY_SCAN_X86
+
+__attribute__((target("sse2"))) static const char *
+skipWhitespaceSSE2(const char *cur, const char *end) {
+  const __m128i space = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'),
+                ctlRange = _mm_set1_epi8('\r' - '\t');
+  for (; end - cur >= 16; cur += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+    // '\t'..'\r' is a contiguous range: (v - '\t') <= 4 as unsigned bytes.
+    __m128i ctl = _mm_sub_epi8(v, tab);
+    __m128i isCtl = _mm_cmpeq_epi8(_mm_min_epu8(ctl, ctlRange), ctl);
+    uint32_t spaceMask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(v, space), isCtl));
+    if (spaceMask != 0xFFFF)
+      return cur + std::countr_zero(~spaceMask);
+  }
+  return skipWhitespaceScalar(cur, end);
+}
+
+__attribute__((target("sse2"))) static const char *
+skipToLineEndSSE2(const char *cur, const char *end) {
+  const __m128i newline = _mm_set1_epi8('\n'), carriage = _mm_set1_epi8('\r'),
+                null = _mm_setzero_si128();
+  for (; end - cur >= 16; cur += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+    uint32_t eolMask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, newline),
+                                  _mm_cmpeq_epi8(v, carriage)),
+                     _mm_cmpeq_epi8(v, null)));
+    if (eolMask)
+      return cur + std::countr_zero(eolMask);
+  }
+  return skipToLineEndScalar(cur, end);
+}
+
+__attribute__((target("sse2"))) static const char *
+skipNumberSSE2(const char *cur, const char *end) {
+  const __m128i zero = _mm_set1_epi8('0'), nine = _mm_set1_epi8(9),
+                dot = _mm_set1_epi8('.');
+  for (; end - cur >= 16; cur += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(cur));
+    __m128i digit = _mm_sub_epi8(v, zero);
+    __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, nine), digit);
+    uint32_t numberMask =
+        _mm_movemask_epi8(_mm_or_si128(isDigit, _mm_cmpeq_epi8(v, dot)));
+    if (numberMask != 0xFFFF)
+      return cur + std::countr_zero(~numberMask);
+  }
+  return skipNumberScalar(cur, end);
+}
+
+__attribute__((target("avx2"))) static const char *
+skipWhitespaceAVX2(const char *cur, const char *end) {
+  const __m256i space = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t'),
+                ctlRange = _mm256_set1_epi8('\r' - '\t');
+  for (; end - cur >= 32; cur += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur));
+    __m256i ctl = _mm256_sub_epi8(v, tab);
+    __m256i isCtl = _mm256_cmpeq_epi8(_mm256_min_epu8(ctl, ctlRange), ctl);
+    uint32_t spaceMask = _mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(v, space), isCtl));
+    if (spaceMask != 0xFFFFFFFF)
+      return cur + std::countr_zero(~spaceMask);
+  }
+  return skipWhitespaceSSE2(cur, end);
+}
+
+__attribute__((target("avx2"))) static const char *
+skipToLineEndAVX2(const char *cur, const char *end) {
+  const __m256i newline = _mm256_set1_epi8('\n'),
+                carriage = _mm256_set1_epi8('\r'),
+                null = _mm256_setzero_si256();
+  for (; end - cur >= 32; cur += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur));
+    uint32_t eolMask = _mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, newline),
+                                        _mm256_cmpeq_epi8(v, carriage)),
+                        _mm256_cmpeq_epi8(v, null)));
+    if (eolMask)
+      return cur + std::countr_zero(eolMask);
+  }
+  return skipToLineEndSSE2(cur, end);
+}
+
+__attribute__((target("avx2"))) static const char *
+skipNumberAVX2(const char *cur, const char *end) {
+  const __m256i zero = _mm256_set1_epi8('0'), nine = _mm256_set1_epi8(9),
+                dot = _mm256_set1_epi8('.');
+  for (; end - cur >= 32; cur += 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cur));
+    __m256i digit = _mm256_sub_epi8(v, zero);
+    __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, nine), digit);
+    uint32_t numberMask = _mm256_movemask_epi8(
+        _mm256_or_si256(isDigit, _mm256_cmpeq_epi8(v, dot)));
+    if (numberMask != 0xFFFFFFFF)
+      return cur + std::countr_zero(~numberMask);
+  }
+  return skipNumberSSE2(cur, end);
+}
+
+static const ScanKernels sse2Kernels = {skipWhitespaceSSE2, skipToLineEndSSE2,
+                                        skipNumberSSE2, ScanISA::SSE2};
+static const ScanKernels avx2Kernels = {skipWhitespaceAVX2, skipToLineEndAVX2,
+                                        skipNumberAVX2, ScanISA::AVX2};
+
+#endif // TOY_SCAN_X86
+
+//===----------------------------------------------------------------------===//
+// Runtime selection
+//===----------------------------------------------------------------------===//
+
+const ScanKernels *toy::getScanKernels(ScanISA isa) {
+  switch (isa) {
+  case ScanISA::Scalar:
+    return &scalarKernels;
+#ifdef TOY_SCAN_X86
+  case ScanISA::SSE2:
+    return __builtin_cpu_supports("sse2") ? &sse2Kernels : nullptr;
+  case ScanISA::AVX2:
+    return __builtin_cpu_supports("avx2") ? &avx2Kernels : nullptr;
+#endif
+  default:
+    return nullptr;
+  }
+}
+
+const ScanKernels &toy::getScanKernels() {
+  static const ScanKernels *best = [] {
+    const ScanISA preferred[] = {ScanISA::AVX2, ScanISA::SSE2};
+    for (ScanISA isa : preferred)
+      if (const ScanKernels *kernels = getScanKernels(isa))
+        return kernels;
+    return &scalarKernels;
+  }();
+  return *best;
+}
+
+const char *toy::getScanISAName(ScanISA isa) {
+  switch (isa) {
+  case ScanISA::Scalar:
+    return "scalar";
+  case ScanISA::SSE2:
+    return "sse2";
+  case ScanISA::AVX2:
+    return "avx2";
+  }
+  return "unknown";
+}
@@ -0,0 +1,60 @@
+//===- Location.cpp - Source locations for the Toy language ---------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the decoding of source locations into line and column
+// numbers.
+//
+//===----------------------------------------------------------------------===//
+
+#include "toy/Location.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace toy;
+
+LineColumn SourceFile::getLineColumn(Location loc) const {
+  if (buffer) {
+    std::call_once(lineStartsComputed, [&] {
+      llvm::StringRef contents = buffer->getBuffer();
+      lineStarts.push_back(0);
+      for (const char *cur = contents.begin(), *end = contents.end();
+           (cur = static_cast<const char *>(
+                std::memchr(cur, '\n', end - cur)));
+           ++cur)
+        lineStarts.push_back(cur + 1 - contents.begin());
+    });
+  }
+
+  // Find the last line starting at or before the location, which is unknown
+  // when it was released.
+  auto lineStart = std::upper_bound(lineStarts.begin() + firstLine,
+                                    lineStarts.end(), loc.offset);
+  if (lineStart == lineStarts.begin() + firstLine)
+    return {0, 0};
+  --lineStart;
+  size_t index = lineStart - lineStarts.begin();
+  int64_t line = lineNumbers.empty() ? static_cast<int64_t>(index) + 1
+                                     : lineNumbers[index];
+  return {line, static_cast<int64_t>(loc.offset - *lineStart) + 1};
+}
+
+void SourceFile::releaseLinesBefore(Location loc) {
+  if (buffer)
+    return;
+  auto lineStart = std::upper_bound(lineStarts.begin() + firstLine,
+                                    lineStarts.end(), loc.offset);
+  if (lineStart == lineStarts.begin() + firstLine)
+    return;
+  firstLine = lineStart - lineStarts.begin() - 1;
+  if (firstLine * 2 < lineStarts.size())
+    return;
+  lineStarts.erase(lineStarts.begin(), lineStarts.begin() + firstLine);
+  lineNumbers.erase(lineNumbers.begin(), lineNumbers.begin() + firstLine);
+  firstLine = 0;
+}
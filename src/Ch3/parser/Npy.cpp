@@ -0,0 +1,172 @@
+//===- Npy.cpp - NumPy array files for the Toy language -------------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the reading and writing of NumPy `.npy` files. A file
+// starts with a magic string, the version of the format and the size of a
+// textual header, followed by the raw values of the array. See
+// https://numpy.org/doc/stable/reference/generated/numpy.lib.format.html
+//
+//===----------------------------------------------------------------------===//
+
+#include "toy/Npy.h"
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileOutputBuffer.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/SwapByteOrder.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <numeric>
+#include <string>
+
+using namespace toy;
+
+static llvm::Error makeError(const llvm::Twine &message) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(), message);
+}
+
+/// Return the text following `key` and a colon in `header`, a Python
+/// dictionary literal like:
+///   {'descr': '<f8', 'fortran_order': False, 'shape': (2, 3), }
+static llvm::StringRef getHeaderValue(llvm::StringRef header,
+                                      llvm::StringRef key) {
+  size_t pos = header.find(("'" + key + "'").str());
+  if (pos == llvm::StringRef::npos)
+    return {};
+  llvm::StringRef value = header.drop_front(pos + key.size() + 2).ltrim();
+  if (!value.consume_front(":"))
+    return {};
+  return value.ltrim();
+}
+
+/// Return the magic string, version, size and header of a `.npy` file holding
+/// 64-bit floats in the byte order of the host, padded so that the values
+/// following it are aligned on 64 bytes as NumPy does.
+static std::string getNpyHeader(llvm::ArrayRef<int64_t> shape) {
+  std::string dict;
+  llvm::raw_string_ostream os(dict);
+  os << "{'descr': '" << (llvm::sys::IsLittleEndianHost ? '<' : '>')
+     << "f8', 'fortran_order': False, 'shape': (";
+  llvm::interleave(shape, os, ", ");
+  os << (shape.size() == 1 ? ",), }" : "), }");
+
+  // The size of the header only needs 32 bits for huge ranks.
+  bool version1 = dict.size() + 64 <= UINT16_MAX;
+  size_t prefixSize = version1 ? 10 : 12;
+  dict.append((64 - (prefixSize + dict.size() + 1) % 64) % 64, ' ');
+  dict += '\n';
+
+  std::string header = "\x93NUMPY";
+  header += version1 ? '\x01' : '\x02';
+  header += '\0';
+  char size[4];
+  if (version1) {
+    llvm::support::endian::write16le(size, dict.size());
+    header.append(size, 2);
+  } else {
+    llvm::support::endian::write32le(size, dict.size());
+    header.append(size, 4);
+  }
+  return header + dict;
+}
+
+llvm::Error toy::writeNpyFile(llvm::StringRef path,
+                              llvm::ArrayRef<int64_t> shape,
+                              llvm::ArrayRef<double> data) {
+  assert(std::accumulate(shape.begin(), shape.end(), int64_t(1),
+                         std::multiplies<int64_t>()) ==
+             static_cast<int64_t>(data.size()) &&
+         "shape doesn't match the number of values");
+  std::string header = getNpyHeader(shape);
+  size_t dataSize = data.size() * sizeof(double);
+  llvm::Expected<std::unique_ptr<llvm::FileOutputBuffer>> bufferOrErr =
+      llvm::FileOutputBuffer::create(path, header.size() + dataSize);
+  if (!bufferOrErr)
+    return bufferOrErr.takeError();
+  uint8_t *out = (*bufferOrErr)->getBufferStart();
+  std::memcpy(out, header.data(), header.size());
+  if (dataSize)
+    std::memcpy(out + header.size(), data.data(), dataSize);
+  return (*bufferOrErr)->commit();
+}
+
+llvm::Expected<NpyArray> toy::readNpyFile(llvm::StringRef path) {
+  auto fileOrErr =
+      llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                  /*RequiresNullTerminator=*/false);
+  if (!fileOrErr)
+    return llvm::errorCodeToError(fileOrErr.getError());
+  NpyArray array;
+  array.buffer = std::move(*fileOrErr);
+  llvm::StringRef contents = array.buffer->getBuffer();
+
+  // Version 1 of the format stores the size of the header on 16 bits, later
+  // versions on 32 bits.
+  if (!contents.consume_front("\x93NUMPY") || contents.size() < 4)
+    return makeError("not a .npy file");
+  unsigned majorVersion = static_cast<unsigned char>(contents[0]);
+  size_t headerSize;
+  if (majorVersion == 1) {
+    headerSize = llvm::support::endian::read16le(contents.data() + 2);
+    contents = contents.drop_front(4);
+  } else if (majorVersion == 2 || majorVersion == 3) {
+    if (contents.size() < 6)
+      return makeError("truncated header");
+    headerSize = llvm::support::endian::read32le(contents.data() + 2);
+    contents = contents.drop_front(6);
+  } else {
+    return makeError("unsupported .npy format version " +
+                     llvm::Twine(majorVersion));
+  }
+  if (contents.size() < headerSize)
+    return makeError("truncated header");
+  llvm::StringRef header = contents.take_front(headerSize);
+  llvm::StringRef data = contents.drop_front(headerSize);
+
+  llvm::StringRef descr = getHeaderValue(header, "descr");
+  if (!descr.consume_front(llvm::sys::IsLittleEndianHost ? "'<f8'" : "'>f8'"))
+    return makeError("unsupported element type, expected 64-bit floats in the "
+                     "byte order of the host");
+  if (!getHeaderValue(header, "fortran_order").consume_front("False"))
+    return makeError("column-major arrays are not supported");
+
+  // The shape is a tuple of integers: `()`, `(3,)` or `(2, 3)`.
+  llvm::StringRef shape = getHeaderValue(header, "shape");
+  if (!shape.consume_front("("))
+    return makeError("malformed shape");
+  int64_t numElements = 1;
+  while (true) {
+    shape = shape.ltrim();
+    if (shape.consume_front(")"))
+      break;
+    int64_t dim;
+    if (shape.consumeInteger(10, dim) || dim < 0 ||
+        llvm::MulOverflow(numElements, dim, numElements) ||
+        numElements > static_cast<int64_t>(SIZE_MAX / sizeof(double)))
+      return makeError("malformed shape");
+    array.shape.push_back(dim);
+    shape = shape.ltrim();
+    shape.consume_front(",");
+  }
+
+  if (data.size() != numElements * sizeof(double))
+    return makeError("expected " + llvm::Twine(numElements * sizeof(double)) +
+                     " bytes of data, but the file has " +
+                     llvm::Twine(data.size()));
+  if (reinterpret_cast<uintptr_t>(data.data()) % alignof(double))
+    return makeError("misaligned data");
+  array.data = llvm::ArrayRef<double>(
+      reinterpret_cast<const double *>(data.data()), numElements);
+  return array;
+}
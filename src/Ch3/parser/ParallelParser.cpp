@@ -0,0 +1,132 @@
+//===- ParallelParser.cpp - Parallel parsing of Toy modules ---------------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the parallel frontend for the Toy language. Blocks are
+// the only construct using braces and cannot be nested, so a `def` keyword
+// found outside of any brace pair, comment or string starts a new definition.
+// On malformed input the chunks may not match the definitions, but the serial
+// parser would fail in the same chunk, before reaching the first misplaced
+// boundary.
+//
+// Each chunk is lexed up to the end of the file and parsed until the `def`
+// starting the next one, so that a definition failing at the end of a chunk
+// sees the same next token as in the serial parser instead of an end of file.
+//
+//===----------------------------------------------------------------------===//
+
+#include "toy/ParallelParser.h"
+#include "toy/Lexer.h"
+#include "toy/Parser.h"
+
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+using namespace toy;
+
+/// The size of the chunks of input parsed as separate tasks. It doesn't depend
+/// on the number of threads, so that the chunks are the same on every host.
+static constexpr size_t chunkSize = 64 * 1024;
+
+/// Return true if `c` can be part of the token preceding or following a `def`
+/// keyword, including the suffix of a malformed number like `1def`.
+static bool isWordChar(char c) {
+  return llvm::isAlnum(c) || c == '_' || c == '.';
+}
+
+std::vector<size_t> toy::findTopLevelDefinitions(llvm::StringRef buffer) {
+  std::vector<size_t> defs;
+  size_t depth = 0;
+  for (size_t i = 0, e = buffer.size(); i < e; ++i) {
+    switch (buffer[i]) {
+    case '\0':
+      return defs;
+    case '#':
+      // Comments run until the end of the line.
+      i = buffer.find_first_of("\n\r", i);
+      if (i == llvm::StringRef::npos)
+        return defs;
+      break;
+    case '"': {
+      // Strings run until the closing quote. An unterminated string is a lex
+      // error, reported in this chunk anyway: the line end is processed as
+      // usual.
+      i = buffer.find_first_of(llvm::StringRef("\"\n\r\0", 4), i + 1);
+      if (i == llvm::StringRef::npos)
+        return defs;
+      if (buffer[i] != '"')
+        --i;
+      break;
+    }
+    case '{':
+      ++depth;
+      break;
+    case '}':
+      // A stray '}' is a parse error, which is reported in this chunk anyway.
+      if (depth)
+        --depth;
+      break;
+    case 'd':
+      if (depth == 0 && buffer.substr(i, 3) == "def" &&
+          (i == 0 || !isWordChar(buffer[i - 1])) &&
+          (i + 3 == e || !isWordChar(buffer[i + 3])))
+        defs.push_back(i);
+      break;
+    default:
+      break;
+    }
+  }
+  return defs;
+}
+
+std::unique_ptr<ModuleAST>
+toy::parseModuleInParallel(std::shared_ptr<SourceFile> file) {
+  llvm::StringRef buffer = file->getContents();
+
+  // Group consecutive definitions into chunks of similar size. The first chunk
+  // starts at the beginning of the buffer and includes the first definition,
+  // so that anything before it is diagnosed as part of that definition.
+  std::vector<size_t> defs = findTopLevelDefinitions(buffer);
+  std::vector<size_t> chunkStarts = {0};
+  for (size_t i = 1, e = defs.size(); i < e; ++i)
+    if (defs[i] - chunkStarts.back() >= chunkSize)
+      chunkStarts.push_back(defs[i]);
+  chunkStarts.push_back(buffer.size());
+
+  struct Chunk {
+    std::unique_ptr<ModuleAST> module;
+    std::string diagnostics;
+  };
+  std::vector<Chunk> chunks(chunkStarts.size() - 1);
+  llvm::parallelFor(0, chunks.size(), [&](size_t i) {
+    llvm::raw_string_ostream os(chunks[i].diagnostics);
+    LexerMemoryBuffer lexer(file, chunkStarts[i], buffer.size());
+    lexer.setDiagnosticStream(os);
+    Parser parser(lexer);
+    std::optional<uint64_t> end;
+    if (i + 1 != chunks.size())
+      end = chunkStarts[i + 1];
+    chunks[i].module = parser.parseModule(end);
+  });
+
+  // Report the diagnostics in source order. Parsing the whole buffer stops at
+  // the first definition failing to parse, so the later chunks are ignored.
+  // Any definition failing makes its chunk and the whole parse fail.
+  std::vector<std::unique_ptr<ModuleAST>> modules;
+  for (Chunk &chunk : chunks) {
+    llvm::errs() << chunk.diagnostics;
+    if (!chunk.module)
+      return nullptr;
+    modules.push_back(std::move(chunk.module));
+  }
+  return std::make_unique<ModuleAST>(modules);
+}
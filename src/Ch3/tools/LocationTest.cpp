@@ -0,0 +1,77 @@
+//===- LocationTest.cpp - Drive the line table of a Toy source file -------===//
+//
+// Part of the LLVM Project, under the Apache License v2.0 with LLVM Exceptions.
+// See https://llvm.org/LICENSE.txt for license information.
+// SPDX-License-Identifier: Apache-2.0 WITH LLVM-exception
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements a tool running a sequence of operations on the line
+// table of a source file that isn't kept in memory, as recorded by the lexer
+// of a stream. It lets the tests reach offsets that would take gigabytes of
+// input to lex, and locations the compiler never decodes. The operations are
+// given as arguments, and are one of:
+//
+//   line:<line>:<offset>   record that line number <line> starts at <offset>
+//   release:<offset>       release the lines before the one holding <offset>
+//   decode:<offset>        print "<offset>: <line>:<col>" for <offset>
+//
+//===----------------------------------------------------------------------===//
+
+#include "toy/Location.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
+#include <string>
+
+using namespace toy;
+namespace cl = llvm::cl;
+
+static cl::list<std::string> operations(cl::Positional, cl::OneOrMore,
+                                        cl::desc("<operation>..."));
+
+/// Parse `operation` into its name and its decimal fields, and return whether
+/// it is well formed.
+static bool parseOperation(llvm::StringRef operation, llvm::StringRef &name,
+                           llvm::SmallVectorImpl<uint64_t> &fields) {
+  llvm::SmallVector<llvm::StringRef, 3> parts;
+  operation.split(parts, ':');
+  name = parts.front();
+  for (llvm::StringRef part :
+       llvm::ArrayRef<llvm::StringRef>(parts).drop_front()) {
+    uint64_t field;
+    if (part.getAsInteger(10, field))
+      return false;
+    fields.push_back(field);
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  cl::ParseCommandLineOptions(argc, argv,
+                              "toy source file line table driver\n");
+
+  SourceFile file("<test>");
+  for (llvm::StringRef operation : operations) {
+    llvm::StringRef name;
+    llvm::SmallVector<uint64_t, 2> fields;
+    bool valid = parseOperation(operation, name, fields);
+    if (valid && name == "line" && fields.size() == 2) {
+      file.addLineStart(fields[0], fields[1]);
+    } else if (valid && name == "release" && fields.size() == 1) {
+      file.releaseLinesBefore({fields[0]});
+    } else if (valid && name == "decode" && fields.size() == 1) {
+      LineColumn lineCol = file.getLineColumn({fields[0]});
+      llvm::outs() << fields[0] << ": " << lineCol.line << ":" << lineCol.col
+                   << "\n";
+    } else {
+      llvm::errs() << "invalid operation '" << operation << "'\n";
+      return 1;
+    }
+  }
+  return 0;
+}
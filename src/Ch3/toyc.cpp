@@ -13,10 +13,13 @@
 #include "mlir/IR/Diagnostics.h"
 #include "mlir/Support/LogicalResult.h"
 #include "toy/AST.h"
+#include "toy/ASTExport.h"
 #include "toy/Dialect.h"
 #include "toy/Lexer.h"
 #include "toy/MLIRGen.h"
+#include "toy/ParallelParser.h"
 #include "toy/Parser.h"
+#include "toy/Passes.h"
 
 #include "mlir/IR/AsmState.h"
 #include "mlir/IR/BuiltinOps.h"
@@ -26,13 +29,19 @@
 #include "mlir/Pass/PassManager.h"
 #include "mlir/Transforms/Passes.h"
 
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ErrorOr.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/raw_ostream.h"
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <system_error>
 #include <utility>
@@ -55,38 +64,208 @@ static cl::opt<enum InputType> inputType(
                           "load the input file as an MLIR file")));
 
 namespace {
-enum Action { None, DumpAST, DumpMLIR };
+enum Action { None, DumpAST, DumpASTJSON, DumpASTBinary, DumpMLIR };
 } // namespace
 static cl::opt<enum Action> emitAction(
     "emit", cl::desc("Select the kind of output desired"),
     cl::values(clEnumValN(DumpAST, "ast", "output the AST dump")),
+    cl::values(clEnumValN(DumpASTJSON, "ast-json", "output the AST as JSON")),
+    cl::values(clEnumValN(DumpASTBinary, "ast-binary",
+                          "output the AST in a compact binary format")),
     cl::values(clEnumValN(DumpMLIR, "mlir", "output the MLIR dump")));
 
+static cl::opt<std::string> outputFilename(
+    "o",
+    cl::desc("Output filename, the AST and MLIR dumps are printed to the "
+             "standard error and the other outputs to the standard output by "
+             "default"),
+    cl::value_desc("filename"));
+
+static cl::opt<int64_t> astLiteralLimit(
+    "ast-literal-limit",
+    cl::desc("Summarize the literals of the AST outputs with more values than "
+             "this, by their first values (-1 for no limit)"),
+    cl::init(-1));
+
 static cl::opt<bool> enableOpt("opt", cl::desc("Enable optimizations"));
 
-/// Returns a Toy AST resulting from parsing the file or a nullptr on error.
-std::unique_ptr<toy::ModuleAST> parseInputFile(llvm::StringRef filename) {
+static cl::opt<bool> foldASTConstants(
+    "fold-ast-constants",
+    cl::desc("Fold the additions and multiplications of numbers in the AST "
+             "before emitting it"));
+
+namespace {
+enum VerifyMode { VerifyOff, VerifyFinal, VerifyEach };
+} // namespace
+static cl::opt<enum VerifyMode> verifyMode(
+    "verify",
+    cl::desc("Select when the IR is verified, the functions of a module being "
+             "verified in parallel"),
+    cl::init(VerifyEach),
+    cl::values(clEnumValN(VerifyOff, "off",
+                          "never verify the IR, for trusted inputs")),
+    cl::values(clEnumValN(VerifyFinal, "final",
+                          "only verify the IR before printing it")),
+    cl::values(clEnumValN(VerifyEach, "each",
+                          "verify the IR once loaded and after every pass")));
+
+static cl::opt<LocationGranularity> locationGranularity(
+    "loc", cl::desc("Granularity of the locations of the emitted MLIR"),
+    cl::init(LocationGranularity::Full),
+    cl::values(clEnumValN(LocationGranularity::Full, "full",
+                          "the file, line and column of every operation")),
+    cl::values(clEnumValN(LocationGranularity::Function, "func",
+                          "the location of the enclosing function")),
+    cl::values(clEnumValN(LocationGranularity::None, "none",
+                          "unknown locations only")));
+
+static cl::opt<bool>
+    parallelParse("parallel-parse",
+                  cl::desc("Parse the top-level definitions of a Toy file in "
+                           "parallel"));
+
+static cl::opt<bool> parallelMLIRGen(
+    "parallel-mlirgen",
+    cl::desc("Emit the MLIR of the functions of a Toy file in parallel"));
+
+static cl::opt<uint64_t> literalResourceThreshold(
+    "literal-resource-threshold",
+    cl::desc("Size in bytes above which the data of literals is held in a "
+             "resource blob"),
+    cl::init(MLIRGenOptions().literalResourceThreshold));
+
+static cl::opt<bool> streamFunctions(
+    "stream-functions",
+    cl::desc("Compile a Toy file one function at a time, releasing each "
+             "function once it has been printed, without inlining calls"));
+
+/// Returns the Toy source file to compile or a nullptr on error.
+std::shared_ptr<SourceFile> openInputFile(llvm::StringRef filename) {
   llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> fileOrErr =
       llvm::MemoryBuffer::getFileOrSTDIN(filename);
   if (std::error_code ec = fileOrErr.getError()) {
     llvm::errs() << "Could not open input file: " << ec.message() << "\n";
     return nullptr;
   }
-  auto buffer = fileOrErr.get()->getBuffer();
-  LexerBuffer lexer(buffer.begin(), buffer.end(), std::string(filename));
-  Parser parser(lexer);
+  return std::make_shared<SourceFile>(std::move(*fileOrErr));
+}
+
+/// Returns a lexer for the Toy source file or a nullptr on error. Files are
+/// loaded in memory and scanned in place, while the standard input is read
+/// incrementally so that lexing overlaps with the program producing it.
+std::unique_ptr<Lexer> createLexer(llvm::StringRef filename) {
+  if (filename == "-")
+    return std::make_unique<LexerFileDescriptor>(
+        llvm::sys::fs::getStdinHandle(), "<stdin>");
+  auto file = openInputFile(filename);
+  if (!file)
+    return nullptr;
+  return std::make_unique<LexerMemoryBuffer>(std::move(file));
+}
+
+/// Returns a Toy AST resulting from parsing the file or a nullptr on error.
+std::unique_ptr<toy::ModuleAST> parseInputFile(llvm::StringRef filename) {
+  // The parallel parser splits the whole input, so it has to be in memory.
+  if (parallelParse) {
+    auto file = openInputFile(filename);
+    if (!file)
+      return nullptr;
+    return parseModuleInParallel(std::move(file));
+  }
+  auto lexer = createLexer(filename);
+  if (!lexer)
+    return nullptr;
+  Parser parser(*lexer);
   return parser.parseModule();
 }
 
+/// Run `print` on the output stream and return its error code. The stream is
+/// the file given with `-o`, which is only kept when `print` succeeds, and
+/// otherwise the standard error for the dumps meant to be read and the
+/// standard output for the others. Either way the stream is buffered, as the
+/// standard error otherwise writes every piece of the output on its own.
+int withOutputStream(bool toStderr, bool binary,
+                     llvm::function_ref<int(llvm::raw_ostream &)> print) {
+  if (outputFilename.empty() && toStderr) {
+    llvm::errs().SetBuffered();
+    int error = print(llvm::errs());
+    llvm::errs().SetUnbuffered();
+    return error;
+  }
+
+  std::error_code ec;
+  llvm::ToolOutputFile output(
+      outputFilename.empty() ? llvm::StringRef("-")
+                             : llvm::StringRef(outputFilename),
+      ec, binary ? llvm::sys::fs::OF_None : llvm::sys::fs::OF_Text);
+  if (ec) {
+    llvm::errs() << "Could not open output file: " << ec.message() << "\n";
+    return 7;
+  }
+  if (int error = print(output.os()))
+    return error;
+  output.keep();
+  return 0;
+}
+
+/// Returns the number of values above which the AST outputs summarize
+/// literals, if any.
+std::optional<size_t> getASTLiteralLimit() {
+  if (astLiteralLimit < 0)
+    return std::nullopt;
+  return astLiteralLimit;
+}
+
+/// Returns the options of the IR generation selected on the command line.
+MLIRGenOptions getMLIRGenOptions() {
+  MLIRGenOptions options;
+  options.locations = locationGranularity;
+  options.literalResourceThreshold = literalResourceThreshold;
+  options.parallel = parallelMLIRGen;
+  options.verify = verifyMode == VerifyEach;
+  return options;
+}
+
+/// Returns whether the input file is a Toy source rather than MLIR.
+bool isToyInput() {
+  return inputType != InputType::MLIR &&
+         !llvm::StringRef(inputFilename).ends_with(".mlir");
+}
+
+/// Populate the pass manager with the optimization pipeline. Calls are only
+/// inlined when `inlineCalls` is set, as it requires the whole module.
+mlir::LogicalResult configurePassManager(mlir::PassManager &pm,
+                                         bool inlineCalls) {
+  // Apply any generic pass manager command line options.
+  if (mlir::failed(mlir::applyPassManagerCLOptions(pm)))
+    return mlir::failure();
+  pm.enableVerifier(verifyMode == VerifyEach);
+
+  // Inline all functions into main and then delete them, so that the
+  // optimizations below see across the calls.
+  if (inlineCalls) {
+    pm.addPass(mlir::createInlinerPass());
+    pm.addPass(mlir::createSymbolDCEPass());
+  }
+
+  // Now that the shapes of the constants and reshapes are known, propagate
+  // them through each function, then run the canonicalizer to optimize it.
+  mlir::OpPassManager &optPM = pm.nest<mlir::toy::FuncOp>();
+  optPM.addPass(mlir::toy::createShapeInferencePass());
+  optPM.addPass(mlir::createCanonicalizerPass());
+  return mlir::success();
+}
+
 int loadMLIR(llvm::SourceMgr &sourceMgr, mlir::MLIRContext &context,
              mlir::OwningOpRef<mlir::ModuleOp> &module) {
   // Handle '.toy' input to the compiler.
-  if (inputType != InputType::MLIR &&
-      !llvm::StringRef(inputFilename).ends_with(".mlir")) {
+  if (isToyInput()) {
     auto moduleAST = parseInputFile(inputFilename);
     if (!moduleAST)
       return 6;
-    module = mlirGen(context, *moduleAST);
+    if (foldASTConstants)
+      foldConstants(*moduleAST);
+    module = mlirGen(context, *moduleAST, getMLIRGenOptions());
     return !module ? 1 : 0;
   }
 
@@ -100,7 +279,9 @@ int loadMLIR(llvm::SourceMgr &sourceMgr, mlir::MLIRContext &context,
 
   // Parse the input mlir.
   sourceMgr.AddNewSourceBuffer(std::move(*fileOrErr), llvm::SMLoc());
-  module = mlir::parseSourceFile<mlir::ModuleOp>(sourceMgr, &context);
+  mlir::ParserConfig config(&context,
+                            /*verifyAfterParse=*/verifyMode == VerifyEach);
+  module = mlir::parseSourceFile<mlir::ModuleOp>(sourceMgr, config);
   if (!module) {
     llvm::errs() << "Error can't load file " << inputFilename << "\n";
     return 3;
@@ -108,31 +289,93 @@ int loadMLIR(llvm::SourceMgr &sourceMgr, mlir::MLIRContext &context,
   return 0;
 }
 
+/// Verify `op` before printing it when only the final IR is verified.
+mlir::LogicalResult verifyFinalIR(mlir::Operation *op) {
+  if (verifyMode != VerifyFinal)
+    return mlir::success();
+  return mlir::verify(op);
+}
+
+/// Compile a Toy file one function at a time. Each function is parsed into an
+/// AST of its own, emitted into an otherwise empty module, optimized and
+/// printed, then both the AST and the IR are released before the next function
+/// is parsed. The functions are printed as top-level operations, which the MLIR
+/// parser wraps back into a module.
+int streamMLIR(mlir::MLIRContext &context, llvm::raw_ostream &os) {
+  auto lexer = createLexer(inputFilename);
+  if (!lexer)
+    return -1;
+  Parser parser(*lexer);
+
+  mlir::OwningOpRef<mlir::ModuleOp> module =
+      mlir::ModuleOp::create(mlir::UnknownLoc::get(&context));
+  mlir::PassManager pm(module.get()->getName());
+  // The callees of a function may have been released already, and the
+  // functions that are private would be deleted as unused: nothing is inlined.
+  if (enableOpt &&
+      mlir::failed(configurePassManager(pm, /*inlineCalls=*/false)))
+    return 4;
+
+  while (true) {
+    auto moduleAST = parser.parseNextFunction();
+    if (!moduleAST)
+      return 6;
+    if (moduleAST->begin() == moduleAST->end())
+      return 0;
+    if (foldASTConstants)
+      foldConstants(*moduleAST);
+
+    if (mlir::failed(mlirGen(*module, *moduleAST, getMLIRGenOptions())))
+      return 1;
+    if (enableOpt && mlir::failed(pm.run(*module)))
+      return 4;
+    if (mlir::failed(verifyFinalIR(*module)))
+      return 1;
+
+    for (mlir::Operation &op :
+         llvm::make_early_inc_range(module->getBody()->getOperations())) {
+      op.remove();
+      op.print(os, mlir::OpPrintingFlags().useLocalScope());
+      os << "\n";
+      op.destroy();
+    }
+    // The locations of the function won't be decoded anymore.
+    lexer->getSourceFile()->releaseLinesBefore(lexer->getLastLocation());
+  }
+}
+
 int dumpMLIR() {
   mlir::MLIRContext context;
   // Load our Dialect in this MLIR Context.
   context.getOrLoadDialect<mlir::toy::ToyDialect>();
 
-  mlir::OwningOpRef<mlir::ModuleOp> module;
   llvm::SourceMgr sourceMgr;
   mlir::SourceMgrDiagnosticHandler sourceMgrHandler(sourceMgr, &context);
+  if (streamFunctions && isToyInput())
+    return withOutputStream(
+        /*toStderr=*/true, /*binary=*/false,
+        [&](llvm::raw_ostream &os) { return streamMLIR(context, os); });
+
+  mlir::OwningOpRef<mlir::ModuleOp> module;
   if (int error = loadMLIR(sourceMgr, context, module))
     return error;
 
   if (enableOpt) {
     mlir::PassManager pm(module.get()->getName());
-    // Apply any generic pass manager command line options and run the pipeline.
-    if (mlir::failed(mlir::applyPassManagerCLOptions(pm)))
+    if (mlir::failed(configurePassManager(pm, /*inlineCalls=*/true)))
       return 4;
-
-    // Add a run of the canonicalizer to optimize the mlir module.
-    pm.addNestedPass<mlir::toy::FuncOp>(mlir::createCanonicalizerPass());
     if (mlir::failed(pm.run(*module)))
       return 4;
   }
+  if (mlir::failed(verifyFinalIR(*module)))
+    return 1;
 
-  module->dump();
-  return 0;
+  return withOutputStream(/*toStderr=*/true, /*binary=*/false,
+                          [&](llvm::raw_ostream &os) {
+                            module->print(os);
+                            os << "\n";
+                            return 0;
+                          });
 }
 
 int dumpAST() {
@@ -144,9 +387,21 @@ int dumpAST() {
   auto moduleAST = parseInputFile(inputFilename);
   if (!moduleAST)
     return 1;
+  if (foldASTConstants)
+    foldConstants(*moduleAST);
 
-  dump(*moduleAST);
-  return 0;
+  std::optional<size_t> literalLimit = getASTLiteralLimit();
+  bool toStderr = emitAction == Action::DumpAST;
+  bool binary = emitAction == Action::DumpASTBinary;
+  return withOutputStream(toStderr, binary, [&](llvm::raw_ostream &os) {
+    if (emitAction == Action::DumpASTJSON)
+      exportJSON(*moduleAST, os, literalLimit);
+    else if (binary)
+      exportBinary(*moduleAST, os, literalLimit);
+    else
+      dump(*moduleAST, os, literalLimit);
+    return 0;
+  });
 }
 
 int main(int argc, char **argv) {
@@ -159,6 +414,8 @@ int main(int argc, char **argv) {
 
   switch (emitAction) {
   case Action::DumpAST:
+  case Action::DumpASTJSON:
+  case Action::DumpASTBinary:
     return dumpAST();
   case Action::DumpMLIR:
     return dumpMLIR();
@@ -0,0 +1,103 @@
+# Print a Toy AST exported with -emit=ast-json or -emit=ast-binary as sorted
+# JSON with floating point numbers, so that both formats can be compared.
+
+import json
+import struct
+import sys
+
+KINDS = ["VarDecl", "Return", "Num", "Literal", "Var", "BinOp", "Call",
+         "Print", "Load", "Save"]
+
+
+class BinaryReader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+        self.strings = []
+
+    def byte(self):
+        self.pos += 1
+        return self.data[self.pos - 1]
+
+    def int(self):
+        value, shift = 0, 0
+        while True:
+            byte = self.byte()
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if byte < 0x80:
+                return value
+
+    def double(self):
+        (value,) = struct.unpack_from("<d", self.data, self.pos)
+        self.pos += 8
+        return value
+
+    def string(self):
+        index = self.int()
+        if index == len(self.strings):
+            size = self.int()
+            self.strings.append(self.data[self.pos:self.pos + size].decode())
+            self.pos += size
+        return self.strings[index]
+
+    def list(self, read):
+        return [read() for _ in range(self.int())]
+
+    def expr(self):
+        kind = KINDS[self.byte()]
+        expr = {"kind": kind, "line": self.int(), "col": self.int()}
+        if kind == "VarDecl":
+            expr["name"] = self.string()
+            expr["shape"] = self.list(self.int)
+        elif kind == "Num":
+            expr["value"] = self.double()
+        elif kind == "Literal":
+            expr["dims"] = self.list(self.int)
+            expr["count"] = self.int()
+            expr["values"] = self.list(self.double)
+        elif kind == "Var":
+            expr["name"] = self.string()
+        elif kind == "BinOp":
+            expr["op"] = chr(self.byte())
+        elif kind == "Call":
+            expr["callee"] = self.string()
+        elif kind in ("Load", "Save"):
+            expr["path"] = self.string()
+        operands = self.list(self.expr)
+        if operands:
+            expr["operands"] = operands
+        return expr
+
+    def module(self):
+        assert self.data[:6] == b"TOYAST", "not a binary Toy AST"
+        self.pos = 6
+        assert self.byte() == 1, "unknown format version"
+        module = {"file": self.string(), "functions": []}
+        for _ in range(self.int()):
+            function = {"name": self.string(), "line": self.int(),
+                        "col": self.int()}
+            function["params"] = self.list(self.string)
+            function["body"] = self.list(self.expr)
+            module["functions"].append(function)
+        assert self.pos == len(self.data), "trailing bytes"
+        return module
+
+
+def floats(value, key=None):
+    if isinstance(value, dict):
+        return {k: floats(v, k) for k, v in value.items()}
+    if isinstance(value, list):
+        return [floats(v, key) for v in value]
+    if key in ("value", "values"):
+        return float(value)
+    return value
+
+
+with open(sys.argv[1], "rb") as f:
+    data = f.read()
+if data.startswith(b"TOYAST"):
+    module = BinaryReader(data).module()
+else:
+    module = json.loads(data)
+print(json.dumps(floats(module), indent=1, sort_keys=True))
@@ -0,0 +1,20 @@
+# Write a NumPy .npy file without NumPy:
+#   write-npy.py <path> <descr> <shape> <values>...
+# where <shape> is a comma separated list of dimensions, empty for a scalar,
+# and <descr> the NumPy type of the values, such as '<f8'.
+
+import struct
+import sys
+
+path, descr, shape = sys.argv[1:4]
+values = [float(value) for value in sys.argv[4:]]
+dims = [int(dim) for dim in shape.split(",") if dim]
+shape = "(" + ", ".join(map(str, dims)) + (",)" if len(dims) == 1 else ")")
+header = "{'descr': '%s', 'fortran_order': False, 'shape': %s, }" % (descr,
+                                                                    shape)
+header += " " * ((64 - (10 + len(header) + 1) % 64) % 64) + "\n"
+with open(path, "wb") as f:
+    f.write(b"\x93NUMPY\x01\x00" + struct.pack("<H", len(header)))
+    f.write(header.encode())
+    format = {"f8": "d", "f4": "f"}[descr[1:]]
+    f.write(struct.pack(descr[0] + format * len(values), *values))
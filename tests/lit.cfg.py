@@ -0,0 +1,38 @@
+# -*- Python -*-
+
+import os
+
+import lit.formats
+
+from lit.llvm import llvm_config
+
+# Configuration file for the 'lit' test runner.
+
+config.name = "TOY"
+config.test_format = lit.formats.ShTest(not llvm_config.use_lit_shell)
+config.suffixes = [".toy", ".mlir"]
+config.test_source_root = os.path.dirname(__file__)
+config.test_exec_root = os.path.join(config.toy_obj_root, "tests")
+
+# Inputs/ holds the files read by the tests, and the examples at the top of
+# the directory have no RUN lines.
+config.excludes = [
+    "Inputs",
+    "CMakeLists.txt",
+    "main.toy",
+    "transpose.mlir",
+    "transpose.toy",
+]
+
+# The tests lexing inputs of several GiB only run when enabled with
+# -DTOY_ENABLE_LONG_TESTS=ON.
+if config.toy_enable_long_tests:
+    config.available_features.add("long-tests")
+
+llvm_config.with_system_environment(["HOME", "INCLUDE", "LIB", "TMP", "TEMP"])
+llvm_config.use_default_substitutions()
+llvm_config.with_environment("PATH", config.llvm_tools_dir, append_path=True)
+
+tool_dirs = [config.toy_tools_dir, config.llvm_tools_dir]
+tools = ["toyc-ch3", "toy-location-test-ch3", "toy-save-bench-ch3"]
+llvm_config.add_tool_substitutions(tools, tool_dirs)